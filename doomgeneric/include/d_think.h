@@ -49,6 +49,11 @@ typedef struct thinker_s {
   struct thinker_s *next;
   think_t function;
 
+  // The same list, less the dormant thinkers, which
+  // have these set to NULL.
+  struct thinker_s *activeprev;
+  struct thinker_s *activenext;
+
 } thinker_t;
 
 #endif
@@ -184,6 +184,9 @@ extern boolean lowres_turn;
 // Quit after playing a demo from cmdline.
 extern boolean singledemo;
 
+// Report how fast a demo played, and quit, after timing a demo from cmdline.
+extern boolean timingdemo;
+
 //?
 extern gamestate_t gamestate;
 
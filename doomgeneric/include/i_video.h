@@ -136,6 +136,26 @@ void I_EnableLoadingDisk(void);
 
 void I_EndRead(void);
 
+#ifdef TRUECOLOR
+// The 3D view can be drawn straight into the 32-bit DG_ScreenBuffer,
+// skipping I_VideoBuffer. I_FinishUpdate then leaves that rectangle of
+// DG_ScreenBuffer alone for the rest of the frame.
+void I_MarkTruecolorRect(int x, int y, int width, int height);
+
+// Address in DG_ScreenBuffer of the top left of screen pixel (x, y), which
+// covers fb_scaling x fb_scaling pixels there.
+uint32_t *I_ScreenBuffer32(int x, int y);
+
+// Mirror a column of 8-bit pixels drawn into I_VideoBuffer on top of the
+// view (e.g. menus, messages) into DG_ScreenBuffer.
+void I_DrawColumn32(int x, int y, byte *source, int count);
+
+// Bring the view back into I_VideoBuffer, for those that read it.
+void I_SyncVideoBuffer(void);
+
+extern int fb_scaling;
+#endif
+
 extern char *video_driver;
 extern boolean screenvisible;
 
@@ -30,9 +30,10 @@
 
 // mapblocks are used to check movement
 // against lines and things
-#define MAPBLOCKUNITS 128
+// 128 units, unless the blockmap was built finer
+#define MAPBLOCKUNITS (1 << MAPBTOFRAC)
 #define MAPBLOCKSIZE (MAPBLOCKUNITS * FRACUNIT)
-#define MAPBLOCKSHIFT (FRACBITS + 7)
+#define MAPBLOCKSHIFT mapblockshift
 #define MAPBMASK (MAPBLOCKSIZE - 1)
 #define MAPBTOFRAC (MAPBLOCKSHIFT - FRACBITS)
 
@@ -64,6 +65,9 @@ extern thinker_t thinkercap;
 void P_InitThinkers(void);
 void P_AddThinker(thinker_t *thinker);
 void P_RemoveThinker(thinker_t *thinker);
+void *P_AllocateThinker(int size);
+void P_DeallocateThinker(void *thinker);
+void P_WakeThinker(thinker_t *thinker);
 
 //
 // P_PSPR
@@ -99,6 +103,7 @@ void P_RemoveMobj(mobj_t *th);
 mobj_t *P_SubstNullMobj(mobj_t *th);
 boolean P_SetMobjState(mobj_t *mobj, statenum_t state);
 void P_MobjThinker(mobj_t *mobj);
+boolean P_MobjDormant(mobj_t *mobj);
 
 void P_SpawnPuff(fixed_t x, fixed_t y, fixed_t z);
 void P_SpawnBlood(fixed_t x, fixed_t y, fixed_t z, int damage);
@@ -131,11 +136,12 @@ typedef struct {
 } intercept_t;
 
 // Extended MAXINTERCEPTS, to allow for intercepts overrun emulation.
+// The intercepts array starts out this big and grows as needed.
 
 #define MAXINTERCEPTS_ORIGINAL 128
 #define MAXINTERCEPTS (MAXINTERCEPTS_ORIGINAL + 61)
 
-extern intercept_t intercepts[MAXINTERCEPTS];
+extern intercept_t *intercepts;
 extern intercept_t *intercept_p;
 
 typedef boolean (*traverser_t)(intercept_t *in);
@@ -155,7 +161,11 @@ extern fixed_t lowfloor;
 void P_LineOpening(line_t *linedef);
 
 boolean P_BlockLinesIterator(int x, int y, boolean (*func)(line_t *));
+boolean P_BlockLinesIteratorBox(int x, int y, fixed_t *box,
+                                boolean (*func)(line_t *));
 boolean P_BlockThingsIterator(int x, int y, boolean (*func)(mobj_t *));
+boolean P_BlockThingsIteratorNear(int x, int y, fixed_t nearx, fixed_t neary,
+                                  fixed_t radius, boolean (*func)(mobj_t *));
 
 #define PT_ADDLINES 1
 #define PT_ADDTHINGS 2
@@ -200,6 +210,7 @@ boolean P_TryMove(mobj_t *thing, fixed_t x, fixed_t y);
 boolean P_TeleportMove(mobj_t *thing, fixed_t x, fixed_t y);
 void P_SlideMove(mobj_t *mo);
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
+void P_ClearSightCache(void);
 void P_UseLines(player_t *player);
 
 boolean P_ChangeSector(sector_t *sector, boolean crunch);
@@ -217,14 +228,41 @@ void P_RadiusAttack(mobj_t *spot, mobj_t *source, int damage);
 // P_SETUP
 //
 extern byte *rejectmatrix;  // for fast sight rejection
-extern short *blockmaplump; // offsets in blockmap are from here
-extern short *blockmap;
+extern int32_t *blockmaplump; // offsets in blockmap are from here
+extern int32_t *blockmap;
+extern int mapblockshift;
 extern int bmapwidth;
 extern int bmapheight; // in mapblocks
 extern fixed_t bmaporgx;
 extern fixed_t bmaporgy;    // origin of block map
 extern mobj_t **blocklinks; // for thing chains
 
+// The things in each mapblock, in the same order as the
+// blocklinks chain but backwards, with copies of the fields
+// needed to tell if a thing is near enough to bother with.
+typedef struct {
+  fixed_t x;
+  fixed_t y;
+  fixed_t radius; // never less than the thing's own
+  mobj_t *mobj;
+} blockthing_t;
+
+typedef struct {
+  int numthings;
+  int maxthings;
+  blockthing_t *things;
+} blockcell_t;
+
+extern blockcell_t *blockcells;
+
+// Line bounding boxes, one per line and apart from line_t,
+// so that lines can be ruled out without touching them.
+typedef struct {
+  fixed_t bbox[4];
+} linebox_t;
+
+extern linebox_t *lineboxes;
+
 //
 // P_INTER
 //
@@ -34,6 +34,10 @@ extern int levelTimeCount;
 // at game start
 void P_InitPicAnims(void);
 
+// Marks every frame of an animated texture
+//  as present if any one of its frames is.
+void P_MarkAnimatedTextures(char *texturepresent);
+
 // at map load
 void P_SpawnSpecials(void);
 
@@ -178,6 +182,10 @@ void P_ChangeSwitchTexture(line_t *line, int useAgain);
 
 void P_InitSwitchList(void);
 
+// Marks both textures of a switch
+//  as present if either one is.
+void P_MarkSwitchTextures(char *texturepresent);
+
 //
 // P_PLATS
 //
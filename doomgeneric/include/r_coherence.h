@@ -0,0 +1,39 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Reuse of the last drawn view when nothing in it has changed.
+//
+
+#ifndef __R_COHERENCE__
+#define __R_COHERENCE__
+
+#include "d_player.h"
+#include "r_defs.h"
+
+// Called by R_Subsector and R_AddLine for everything
+//  that goes into the view being drawn.
+void R_MarkSectorSeen(sector_t *sector);
+void R_MarkLineSeen(seg_t *line);
+
+// Called after R_SetupFrame. If nothing seen in the last
+//  drawn view has changed, puts its pixels back and returns
+//  true, otherwise starts recording a new view.
+boolean R_ViewUnchanged(player_t *player);
+
+// Called once the view is drawn, to remember it if it was
+//  drawn the same as the view before it.
+void R_KeepView(player_t *player);
+
+#endif
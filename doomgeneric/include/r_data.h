@@ -30,6 +30,11 @@ byte *R_GetColumn(int tex, int col);
 void R_InitData(void);
 void R_PrecacheLevel(void);
 
+#ifdef TRUECOLOR
+// Point colormaps32 at the tables for the given palette from PLAYPAL.
+void R_SetTruecolorPalette(byte *palette);
+#endif
+
 // Retrieval.
 // Floor/ceiling opaque texture tiles,
 // lookup by name. For animation?
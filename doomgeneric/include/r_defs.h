@@ -169,8 +169,8 @@ typedef struct line_s {
   short sidenum[2];
 
   // Neat. Another bounding box, for the extent
-  //  of the LineDef.
-  fixed_t bbox[4];
+  //  of the LineDef. Points into lineboxes[].
+  fixed_t *bbox;
 
   // To aid move clipping.
   slopetype_t slopetype;
@@ -19,15 +19,23 @@
 #ifndef __R_DRAW__
 #define __R_DRAW__
 
-extern lighttable_t *dc_colormap;
-extern int dc_x;
-extern int dc_yl;
-extern int dc_yh;
-extern fixed_t dc_iscale;
-extern fixed_t dc_texturemid;
+// With RENDER_THREADS several threads run the drawers at
+//  once (see r_slice.c), so each needs its own draw state.
+#ifdef RENDER_THREADS
+#define DRAW_THREAD_LOCAL _Thread_local
+#else
+#define DRAW_THREAD_LOCAL
+#endif
+
+extern DRAW_THREAD_LOCAL lighttable_t *dc_colormap;
+extern DRAW_THREAD_LOCAL int dc_x;
+extern DRAW_THREAD_LOCAL int dc_yl;
+extern DRAW_THREAD_LOCAL int dc_yh;
+extern DRAW_THREAD_LOCAL fixed_t dc_iscale;
+extern DRAW_THREAD_LOCAL fixed_t dc_texturemid;
 
 // first pixel in a column
-extern byte *dc_source;
+extern DRAW_THREAD_LOCAL byte *dc_source;
 
 // The span blitting interface.
 // Hook in assembler or system specific BLT
@@ -35,6 +43,20 @@ extern byte *dc_source;
 void R_DrawColumn(void);
 void R_DrawColumnLow(void);
 
+#ifdef __wasm_simd128__
+// Bit-exact wasm SIMD128 versions of R_DrawColumn
+//  and R_DrawSpan, used when built with -msimd128.
+void R_DrawColumnSIMD(void);
+void R_DrawSpanSIMD(void);
+
+#ifdef SIMD_CHECK
+// Draw through both the scalar and SIMD versions,
+//  reporting any difference.
+void R_DrawColumnSIMDChecked(void);
+void R_DrawSpanSIMDChecked(void);
+#endif
+#endif
+
 // The Spectre/Invisibility effect.
 void R_DrawFuzzColumn(void);
 void R_DrawFuzzColumnLow(void);
@@ -47,22 +69,24 @@ void R_DrawTranslatedColumnLow(void);
 
 void R_VideoErase(unsigned ofs, int count);
 
-extern int ds_y;
-extern int ds_x1;
-extern int ds_x2;
+extern DRAW_THREAD_LOCAL int ds_y;
+extern DRAW_THREAD_LOCAL int ds_x1;
+extern DRAW_THREAD_LOCAL int ds_x2;
 
-extern lighttable_t *ds_colormap;
+extern DRAW_THREAD_LOCAL lighttable_t *ds_colormap;
 
-extern fixed_t ds_xfrac;
-extern fixed_t ds_yfrac;
-extern fixed_t ds_xstep;
-extern fixed_t ds_ystep;
+extern DRAW_THREAD_LOCAL fixed_t ds_xfrac;
+extern DRAW_THREAD_LOCAL fixed_t ds_yfrac;
+extern DRAW_THREAD_LOCAL fixed_t ds_xstep;
+extern DRAW_THREAD_LOCAL fixed_t ds_ystep;
 
 // start of a 64*64 tile image
-extern byte *ds_source;
+extern DRAW_THREAD_LOCAL byte *ds_source;
 
 extern byte *translationtables;
-extern byte *dc_translation;
+extern DRAW_THREAD_LOCAL byte *dc_translation;
+
+extern DRAW_THREAD_LOCAL int fuzzpos;
 
 // Span blitting for rows, floor/ceiling.
 // No Sepctre effect needed.
@@ -71,6 +95,19 @@ void R_DrawSpan(void);
 // Low resolution mode, 160x200?
 void R_DrawSpanLow(void);
 
+#ifdef TRUECOLOR
+// Versions of all the above that draw straight into
+//  the 32-bit DG_ScreenBuffer, through colormaps32.
+void R_DrawColumn32(void);
+void R_DrawColumnLow32(void);
+void R_DrawFuzzColumn32(void);
+void R_DrawFuzzColumnLow32(void);
+void R_DrawTranslatedColumn32(void);
+void R_DrawTranslatedColumnLow32(void);
+void R_DrawSpan32(void);
+void R_DrawSpanLow32(void);
+#endif
+
 void R_InitBuffer(int width, int height);
 
 // Initialize color translation tables,
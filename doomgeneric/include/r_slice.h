@@ -0,0 +1,38 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Threaded drawing of the view in vertical screen slices.
+//
+
+#ifndef __R_SLICE__
+#define __R_SLICE__
+
+#ifdef RENDER_THREADS
+
+// Start the worker threads that draw the view slices.
+void R_InitSlices(void);
+
+// Swap colfunc, basecolfunc, fuzzcolfunc, transcolfunc and
+//  spanfunc for versions that queue the draw for later.
+// Called whenever the view size sets up new draw functions.
+void R_QueueDrawFuncs(void);
+
+// Draw everything queued since the last flush, split into
+//  RENDER_THREADS vertical slices drawn in parallel.
+void R_FlushSlices(void);
+
+#endif
+
+#endif
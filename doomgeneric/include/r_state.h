@@ -39,6 +39,12 @@ extern fixed_t *spritetopoffset;
 
 extern lighttable_t *colormaps;
 
+#ifdef TRUECOLOR
+// 32-bit BGRA version of colormaps for the current palette and gamma;
+// colormaps32[i] is the color that colormaps[i] stands for.
+extern uint32_t *colormaps32;
+#endif
+
 extern int viewwidth;
 extern int scaledviewwidth;
 extern int viewheight;
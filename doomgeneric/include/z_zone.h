@@ -48,6 +48,7 @@ enum {
 
 void Z_Init(void);
 void *Z_Malloc(int size, int tag, void *ptr);
+void *Z_TryMalloc(int size, int tag, void *ptr);
 void Z_Free(void *ptr);
 void Z_FreeTags(int lowtag, int hightag);
 void Z_DumpHeap(int lowtag, int hightag);
@@ -57,6 +58,7 @@ void Z_ChangeTag2(void *ptr, int tag, char *file, int line);
 void Z_ChangeUser(void *ptr, void **user);
 int Z_FreeMemory(void);
 unsigned int Z_ZoneSize(void);
+unsigned int Z_Operations(void);
 
 //
 // This is used to get the local FILE:LINE info from CPP
@@ -1318,6 +1318,20 @@ void D_DoomMain(void) {
 
     printf("Playing demo %s.\n", file);
   }
+#else
+  // A demo that's already a lump in a loaded WAD can still be played back by
+  // name, the same as Vanilla Doom's "-playdemo demo1" trick.
+  p = M_CheckParmWithArgs("-playdemo", 1);
+
+  if (!p) {
+    p = M_CheckParmWithArgs("-timedemo", 1);
+  }
+
+  if (p) {
+    M_StringCopy(demolumpname, myargv[p + 1], sizeof(demolumpname));
+
+    printf("Playing demo %s.\n", demolumpname);
+  }
 #endif
 
   I_AtExit((atexit_func_t)G_CheckDemoStatus, true);
@@ -107,6 +107,7 @@ boolean usergame;  // ok to save / end game
 boolean timingdemo; // if true, exit with report on completion
 boolean nodrawers;  // for comparative timing purposes
 int starttime;      // for comparative timing purposes
+static unsigned int startzoneops;
 
 boolean viewactive;
 
@@ -1890,6 +1891,7 @@ void G_DoPlayDemo(void) {
   G_InitNew(skill, episode, map);
   precache = true;
   starttime = I_GetTime();
+  startzoneops = Z_Operations();
 
   usergame = false;
   demoplayback = true;
@@ -1929,18 +1931,20 @@ boolean G_CheckDemoStatus(void) {
 
   if (timingdemo) {
     float fps;
+    float zoneops;
     int realtics;
 
     endtime = I_GetTime();
     realtics = endtime - starttime;
     fps = ((float)gametic * TICRATE) / realtics;
+    zoneops = (float)(Z_Operations() - startzoneops) / gametic;
 
     // Prevent recursive calls
     timingdemo = false;
     demoplayback = false;
 
-    I_Error("timed %i gametics in %i realtics (%f fps)", gametic, realtics,
-            fps);
+    I_Error("timed %i gametics in %i realtics (%f fps, %f zone ops/tic)",
+            gametic, realtics, fps, zoneops);
   }
 
   if (demoplayback) {
@@ -37,6 +37,10 @@ static const char rcsid[] = "$Id: i_x.c,v 1.6 1997/02/03 22:45:10 b1 Exp $";
 
 #include "doomgeneric.h"
 
+#ifdef TRUECOLOR
+#include "r_data.h"
+#endif
+
 #include <stdbool.h>
 #include <stdlib.h>
 
@@ -81,6 +85,17 @@ struct color {
 
 static struct color colors[256];
 
+#ifdef TRUECOLOR
+// colors, as they are laid out in DG_ScreenBuffer
+static uint32_t colors32[256];
+
+// The rectangle of the screen drawn straight into DG_ScreenBuffer this
+// frame, if truecolordrawn, and whether the frame last shown had one.
+static int truecolorx, truecolory, truecolorw, truecolorh;
+static boolean truecolordrawn;
+static boolean truecolorshown;
+#endif
+
 void I_GetEvent(void);
 
 // The screen buffer; this is modified to draw things to the screen
@@ -273,6 +288,19 @@ void I_FinishUpdate(void) {
       else {
         // XXX FIXME fb_scaling support!
       }
+#elif defined(TRUECOLOR)
+      if (truecolordrawn && SCREENHEIGHT - 1 - y >= truecolory &&
+          SCREENHEIGHT - 1 - y < truecolory + truecolorh) {
+        // Only the parts of this line either side of the view
+        cmap_to_fb((void *)line_out, (void *)line_in, truecolorx);
+        cmap_to_fb((void *)(line_out + (truecolorx + truecolorw) *
+                                           fb_scaling *
+                                           (s_Fb.bits_per_pixel / 8)),
+                   (void *)(line_in + truecolorx + truecolorw),
+                   SCREENWIDTH - truecolorx - truecolorw);
+      } else {
+        cmap_to_fb((void *)line_out, (void *)line_in, SCREENWIDTH);
+      }
 #else
       // cmap_to_rgb565((void*)line_out, (void*)line_in, SCREENWIDTH);
       cmap_to_fb((void *)line_out, (void *)line_in, SCREENWIDTH);
@@ -283,13 +311,119 @@ void I_FinishUpdate(void) {
     line_in += SCREENWIDTH;
   }
 
+#ifdef TRUECOLOR
+  truecolorshown = truecolordrawn;
+  truecolordrawn = false;
+#endif
+
   DG_DrawFrame();
 }
 
+#ifdef TRUECOLOR
+void I_MarkTruecolorRect(int x, int y, int width, int height) {
+  truecolorx = x;
+  truecolory = y;
+  truecolorw = width;
+  truecolorh = height;
+  truecolordrawn = true;
+}
+
+uint32_t *I_ScreenBuffer32(int x, int y) {
+  // Same horizontal centering as I_FinishUpdate
+  int x_offset = (s_Fb.xres - (SCREENWIDTH * fb_scaling)) / 2;
+
+  return DG_ScreenBuffer + (y * fb_scaling * s_Fb.xres) + x_offset +
+         (x * fb_scaling);
+}
+
+void I_DrawColumn32(int x, int y, byte *source, int count) {
+  uint32_t *dest;
+  int i, j;
+
+  if (!truecolordrawn || x < truecolorx || x >= truecolorx + truecolorw)
+    return;
+
+  if (y < truecolory) {
+    source += truecolory - y;
+    count -= truecolory - y;
+    y = truecolory;
+  }
+  if (y + count > truecolory + truecolorh)
+    count = truecolory + truecolorh - y;
+
+  dest = I_ScreenBuffer32(x, y);
+
+  for (; count > 0; count--) {
+    for (i = 0; i < fb_scaling; i++) {
+      for (j = 0; j < fb_scaling; j++)
+        dest[j] = colors32[*source];
+      dest += s_Fb.xres;
+    }
+    source++;
+  }
+}
+
+//
+// I_SyncVideoBuffer
+// Every pixel of the view came from the current palette, so it can be
+// matched back to its index. Only the fuzz effect makes colors outside the
+// palette, which get the nearest match.
+//
+void I_SyncVideoBuffer(void) {
+  byte *dest;
+  uint32_t pix;
+  uint32_t lastpix;
+  int lastindex;
+  int best_diff, diff;
+  int dr, dg, db;
+  int x, y, i;
+
+  if (!truecolordrawn && !truecolorshown)
+    return;
+
+  lastpix = colors32[0];
+  lastindex = 0;
+
+  for (y = truecolory; y < truecolory + truecolorh; y++) {
+    dest = I_VideoBuffer + y * SCREENWIDTH + truecolorx;
+
+    for (x = truecolorx; x < truecolorx + truecolorw; x++) {
+      pix = *I_ScreenBuffer32(x, y);
+
+      if (pix != lastpix) {
+        lastpix = pix;
+        best_diff = INT_MAX;
+
+        for (i = 0; i < 256 && best_diff != 0; i++) {
+          dr = (int)((pix >> 16) & 0xff) - colors[i].r;
+          dg = (int)((pix >> 8) & 0xff) - colors[i].g;
+          db = (int)(pix & 0xff) - colors[i].b;
+          diff = dr * dr + dg * dg + db * db;
+
+          if (diff < best_diff) {
+            lastindex = i;
+            best_diff = diff;
+          }
+        }
+      }
+
+      *dest++ = lastindex;
+    }
+  }
+
+  // I_VideoBuffer is whole again
+  truecolordrawn = false;
+  truecolorshown = false;
+}
+#endif
+
 //
 // I_ReadScreen
 //
 void I_ReadScreen(byte *scr) {
+#ifdef TRUECOLOR
+  I_SyncVideoBuffer();
+#endif
   memcpy(scr, I_VideoBuffer, SCREENWIDTH * SCREENHEIGHT);
 }
 
@@ -317,6 +451,10 @@ void I_SetPalette(byte *palette) {
   //	palette += 3;
   //}
 
+#ifdef TRUECOLOR
+  R_SetTruecolorPalette(palette);
+#endif
+
   /* performance boost:
    * map to the right pixel format over here! */
 
@@ -325,6 +463,12 @@ void I_SetPalette(byte *palette) {
     colors[i].r = gammatable[usegamma][*palette++];
     colors[i].g = gammatable[usegamma][*palette++];
     colors[i].b = gammatable[usegamma][*palette++];
+
+#ifdef TRUECOLOR
+    colors32[i] = (colors[i].r << s_Fb.red.offset) |
+                  (colors[i].g << s_Fb.green.offset) |
+                  (colors[i].b << s_Fb.blue.offset);
+#endif
   }
 }
 
@@ -23,6 +23,7 @@
 
 #include "m_random.h"
 #include "i_system.h"
+#include "z_zone.h"
 
 #include "doomdef.h"
 #include "p_local.h"
@@ -73,47 +74,132 @@ void A_Fall(mobj_t *actor);
 
 //
 // Called by P_NoiseAlert.
-// Recursively traverse adjacent sectors,
+// Flood through adjacent sectors,
 // sound blocking lines cut off traversal.
 //
 
 mobj_t *soundtarget;
 
-void P_RecursiveSound(sector_t *sec, int soundblocks) {
-  int i;
-  line_t *check;
+// The two-sided lines out of each sector, built once a level.
+// Vanilla Doom walked sector->lines recursively, calling
+//  P_LineOpening on every line, every time something made
+//  a noise.
+
+typedef struct {
+  sector_t *front;
+  sector_t *back;
   sector_t *other;
+  boolean soundblock;
+} soundline_t;
+
+static soundline_t *soundlines;
+static int *soundlinestart;
+static sector_t **soundqueue;
+
+static void P_InitSoundLines(void) {
+  int i, j;
+  int count;
+  line_t *check;
+  soundline_t *soundline;
 
-  // wake up all monsters in this sector
-  if (sec->validcount == validcount && sec->soundtraversed <= soundblocks + 1) {
-    return; // already flooded
+  count = 0;
+
+  for (i = 0; i < numsectors; i++) {
+    for (j = 0; j < sectors[i].linecount; j++) {
+      check = sectors[i].lines[j];
+
+      // One-sided lines, and two-sided lines without a back
+      // sector, never have an opening.
+      if ((check->flags & ML_TWOSIDED) && check->sidenum[1] != -1)
+        count++;
+    }
   }
 
-  sec->validcount = validcount;
-  sec->soundtraversed = soundblocks + 1;
-  sec->soundtarget = soundtarget;
+  soundlines = Z_Malloc(count * sizeof(*soundlines), PU_LEVEL, &soundlines);
+  soundlinestart = Z_Malloc((numsectors + 1) * sizeof(*soundlinestart),
+                            PU_LEVEL, &soundlinestart);
+  soundqueue =
+      Z_Malloc(numsectors * sizeof(*soundqueue), PU_LEVEL, &soundqueue);
 
-  for (i = 0; i < sec->linecount; i++) {
-    check = sec->lines[i];
-    if (!(check->flags & ML_TWOSIDED))
-      continue;
+  soundline = soundlines;
 
-    P_LineOpening(check);
+  for (i = 0; i < numsectors; i++) {
+    soundlinestart[i] = soundline - soundlines;
 
-    if (openrange <= 0)
-      continue; // closed door
+    for (j = 0; j < sectors[i].linecount; j++) {
+      check = sectors[i].lines[j];
 
-    if (sides[check->sidenum[0]].sector == sec)
-      other = sides[check->sidenum[1]].sector;
-    else
-      other = sides[check->sidenum[0]].sector;
+      if (!(check->flags & ML_TWOSIDED) || check->sidenum[1] == -1)
+        continue;
 
-    if (check->flags & ML_SOUNDBLOCK) {
-      if (!soundblocks)
-        P_RecursiveSound(other, 1);
-    } else
-      P_RecursiveSound(other, soundblocks);
+      soundline->front = check->frontsector;
+      soundline->back = check->backsector;
+
+      if (sides[check->sidenum[0]].sector == &sectors[i])
+        soundline->other = sides[check->sidenum[1]].sector;
+      else
+        soundline->other = sides[check->sidenum[0]].sector;
+
+      soundline->soundblock = (check->flags & ML_SOUNDBLOCK) != 0;
+      soundline++;
+    }
+  }
+
+  soundlinestart[numsectors] = soundline - soundlines;
+}
+
+// Whether P_LineOpening would give an openrange above zero.
+static boolean P_SoundLineOpen(soundline_t *soundline) {
+  fixed_t top;
+  fixed_t bottom;
+
+  if (soundline->front->ceilingheight < soundline->back->ceilingheight)
+    top = soundline->front->ceilingheight;
+  else
+    top = soundline->back->ceilingheight;
+
+  if (soundline->front->floorheight > soundline->back->floorheight)
+    bottom = soundline->front->floorheight;
+  else
+    bottom = soundline->back->floorheight;
+
+  return top - bottom > 0;
+}
+
+//
+// P_FloodSound
+// Breadth first, from the sectors already queued, through lines
+//  that are open right now. Sectors reached without crossing a
+//  sound blocking line get soundtraversed 1; the rest of those
+//  reachable by crossing just one get 2, as with the recursive
+//  flood in Vanilla Doom.
+//
+static int P_FloodSound(int head, int tail, int soundblocks) {
+  int i;
+  sector_t *sec;
+  soundline_t *soundline;
+
+  while (head < tail) {
+    sec = soundqueue[head++];
+
+    for (i = soundlinestart[sec - sectors]; i < soundlinestart[sec - sectors + 1];
+         i++) {
+      soundline = &soundlines[i];
+
+      if (soundline->soundblock || soundline->other->validcount == validcount)
+        continue;
+
+      if (!P_SoundLineOpen(soundline))
+        continue; // closed door
+
+      soundline->other->validcount = validcount;
+      soundline->other->soundtraversed = soundblocks + 1;
+      soundline->other->soundtarget = soundtarget;
+      soundqueue[tail++] = soundline->other;
+    }
   }
+
+  return tail;
 }
 
 //
@@ -122,9 +208,48 @@ void P_RecursiveSound(sector_t *sec, int soundblocks) {
 // it will alert other monsters to the player.
 //
 void P_NoiseAlert(mobj_t *target, mobj_t *emmiter) {
+  int i, j;
+  int count;
+  sector_t *sec;
+  soundline_t *soundline;
+
+  if (soundlines == NULL)
+    P_InitSoundLines();
+
   soundtarget = target;
   validcount++;
-  P_RecursiveSound(emmiter->subsector->sector, 0);
+
+  sec = emmiter->subsector->sector;
+  sec->validcount = validcount;
+  sec->soundtraversed = 1;
+  sec->soundtarget = soundtarget;
+  soundqueue[0] = sec;
+
+  // Everything queued by this heard it without a sound block
+  // in the way. Then go one sound block further.
+  count = P_FloodSound(0, 1, 0);
+  j = count;
+
+  for (i = 0; i < count; i++) {
+    sec = soundqueue[i];
+
+    for (soundline = &soundlines[soundlinestart[sec - sectors]];
+         soundline < &soundlines[soundlinestart[sec - sectors + 1]];
+         soundline++) {
+      if (!soundline->soundblock || soundline->other->validcount == validcount)
+        continue;
+
+      if (!P_SoundLineOpen(soundline))
+        continue; // closed door
+
+      soundline->other->validcount = validcount;
+      soundline->other->soundtraversed = 2;
+      soundline->other->soundtarget = soundtarget;
+      soundqueue[j++] = soundline->other;
+    }
+  }
+
+  P_FloodSound(count, j, 1);
 }
 
 //
@@ -221,7 +221,7 @@ int EV_DoFloor(line_t *line, floor_e floortype) {
 
     // new floor thinker
     rtn = 1;
-    floor = Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+    floor = P_AllocateThinker(sizeof(*floor));
     P_AddThinker(&floor->thinker);
     sec->specialdata = floor;
     floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -388,7 +388,7 @@ int EV_BuildStairs(line_t *line, stair_e type) {
 
     // new floor thinker
     rtn = 1;
-    floor = Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+    floor = P_AllocateThinker(sizeof(*floor));
     P_AddThinker(&floor->thinker);
     sec->specialdata = floor;
     floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -438,7 +438,7 @@ int EV_BuildStairs(line_t *line, stair_e type) {
 
         sec = tsec;
         secnum = newsecnum;
-        floor = Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+        floor = P_AllocateThinker(sizeof(*floor));
 
         P_AddThinker(&floor->thinker);
 
@@ -686,6 +686,9 @@ void P_DamageMobj(mobj_t *target, mobj_t *inflictor, mobj_t *source,
   fixed_t thrust;
   int temp;
 
+  // About to be thrust, or change state.
+  P_WakeThinker(&target->thinker);
+
   if (!(target->flags & MF_SHOOTABLE))
     return; // shouldn't happen...
 
@@ -59,7 +59,7 @@ void P_SpawnFireFlicker(sector_t *sector) {
   // Nothing special about it during gameplay.
   sector->special = 0;
 
-  flick = Z_Malloc(sizeof(*flick), PU_LEVSPEC, 0);
+  flick = P_AllocateThinker(sizeof(*flick));
 
   P_AddThinker(&flick->thinker);
 
@@ -102,7 +102,7 @@ void P_SpawnLightFlash(sector_t *sector) {
   // nothing special about it during gameplay
   sector->special = 0;
 
-  flash = Z_Malloc(sizeof(*flash), PU_LEVSPEC, 0);
+  flash = P_AllocateThinker(sizeof(*flash));
 
   P_AddThinker(&flash->thinker);
 
@@ -144,7 +144,7 @@ void T_StrobeFlash(strobe_t *flash) {
 void P_SpawnStrobeFlash(sector_t *sector, int fastOrSlow, int inSync) {
   strobe_t *flash;
 
-  flash = Z_Malloc(sizeof(*flash), PU_LEVSPEC, 0);
+  flash = P_AllocateThinker(sizeof(*flash));
 
   P_AddThinker(&flash->thinker);
 
@@ -195,21 +195,19 @@ void EV_TurnTagLightsOff(line_t *line) {
   sector_t *tsec;
   line_t *templine;
 
-  sector = sectors;
-
-  for (j = 0; j < numsectors; j++, sector++) {
-    if (sector->tag == line->tag) {
-      min = sector->lightlevel;
-      for (i = 0; i < sector->linecount; i++) {
-        templine = sector->lines[i];
-        tsec = getNextSector(templine, sector);
-        if (!tsec)
-          continue;
-        if (tsec->lightlevel < min)
-          min = tsec->lightlevel;
-      }
-      sector->lightlevel = min;
+  j = -1;
+  while ((j = P_FindSectorFromLineTag(line, j)) >= 0) {
+    sector = &sectors[j];
+    min = sector->lightlevel;
+    for (i = 0; i < sector->linecount; i++) {
+      templine = sector->lines[i];
+      tsec = getNextSector(templine, sector);
+      if (!tsec)
+        continue;
+      if (tsec->lightlevel < min)
+        min = tsec->lightlevel;
     }
+    sector->lightlevel = min;
   }
 }
 
@@ -223,27 +221,26 @@ void EV_LightTurnOn(line_t *line, int bright) {
   sector_t *temp;
   line_t *templine;
 
-  sector = sectors;
+  i = -1;
+  while ((i = P_FindSectorFromLineTag(line, i)) >= 0) {
+    sector = &sectors[i];
 
-  for (i = 0; i < numsectors; i++, sector++) {
-    if (sector->tag == line->tag) {
-      // bright = 0 means to search
-      // for highest light level
-      // surrounding sector
-      if (!bright) {
-        for (j = 0; j < sector->linecount; j++) {
-          templine = sector->lines[j];
-          temp = getNextSector(templine, sector);
+    // bright = 0 means to search
+    // for highest light level
+    // surrounding sector
+    if (!bright) {
+      for (j = 0; j < sector->linecount; j++) {
+        templine = sector->lines[j];
+        temp = getNextSector(templine, sector);
 
-          if (!temp)
-            continue;
+        if (!temp)
+          continue;
 
-          if (temp->lightlevel > bright)
-            bright = temp->lightlevel;
-        }
+        if (temp->lightlevel > bright)
+          bright = temp->lightlevel;
       }
-      sector->lightlevel = bright;
     }
+    sector->lightlevel = bright;
   }
 }
 
@@ -276,7 +273,7 @@ void T_Glow(glow_t *g) {
 void P_SpawnGlowingLight(sector_t *sector) {
   glow_t *g;
 
-  g = Z_Malloc(sizeof(*g), PU_LEVSPEC, 0);
+  g = P_AllocateThinker(sizeof(*g));
 
   P_AddThinker(&g->thinker);
 
@@ -162,7 +162,8 @@ boolean P_TeleportMove(mobj_t *thing, fixed_t x, fixed_t y) {
 
   for (bx = xl; bx <= xh; bx++)
     for (by = yl; by <= yh; by++)
-      if (!P_BlockThingsIterator(bx, by, PIT_StompThing))
+      if (!P_BlockThingsIteratorNear(bx, by, tmx, tmy, tmthing->radius,
+                                     PIT_StompThing))
         return false;
 
   // the move is ok,
@@ -368,6 +369,7 @@ boolean PIT_CheckThing(mobj_t *thing) {
 //  numspeciallines
 //
 boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y) {
+  static int nolineboxes = -1;
   int xl;
   int xh;
   int yl;
@@ -415,7 +417,8 @@ boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y) {
 
   for (bx = xl; bx <= xh; bx++)
     for (by = yl; by <= yh; by++)
-      if (!P_BlockThingsIterator(bx, by, PIT_CheckThing))
+      if (!P_BlockThingsIteratorNear(bx, by, tmx, tmy, tmthing->radius,
+                                     PIT_CheckThing))
         return false;
 
   // check lines
@@ -424,9 +427,21 @@ boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y) {
   yl = (tmbbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT;
   yh = (tmbbox[BOXTOP] - bmaporgy) >> MAPBLOCKSHIFT;
 
+  //!
+  // @category obscure
+  //
+  // Check every line in the blocks touched, as Vanilla Doom did,
+  // rather than first ruling lines out by their lineboxes[] entry,
+  // e.g. to compare ms/tic with -timedemo.
+  //
+
+  if (nolineboxes < 0)
+    nolineboxes = M_ParmExists("-nolineboxes");
+
   for (bx = xl; bx <= xh; bx++)
     for (by = yl; by <= yh; by++)
-      if (!P_BlockLinesIterator(bx, by, PIT_CheckLine))
+      if (nolineboxes ? !P_BlockLinesIterator(bx, by, PIT_CheckLine)
+                      : !P_BlockLinesIteratorBox(bx, by, tmbbox, PIT_CheckLine))
         return false;
 
   return true;
@@ -513,6 +528,9 @@ boolean P_ThingHeightClip(mobj_t *thing) {
   P_CheckPosition(thing, thing->x, thing->y);
   // what about stranding a monster partially off an edge?
 
+  // It may have to fall now.
+  P_WakeThinker(&thing->thinker);
+
   thing->floorz = tmfloorz;
   thing->ceilingz = tmceilingz;
 
@@ -1225,6 +1243,9 @@ boolean P_ChangeSector(sector_t *sector, boolean crunch) {
   nofit = false;
   crushchange = crunch;
 
+  // Sight through this sector may have changed.
+  P_ClearSightCache();
+
   // re-check heights for all things near the moving sector
   for (x = sector->blockbox[BOXLEFT]; x <= sector->blockbox[BOXRIGHT]; x++)
     for (y = sector->blockbox[BOXBOTTOM]; y <= sector->blockbox[BOXTOP]; y++)
@@ -21,8 +21,10 @@
 //
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "m_bbox.h"
+#include "z_zone.h"
 
 #include "doomdef.h"
 #include "doomstat.h"
@@ -276,6 +278,47 @@ void P_LineOpening(line_t *linedef) {
 // THING POSITION SETTING
 //
 
+// Bumped whenever a thing goes into or out of a mapblock.
+static int blockcellchanges;
+
+static void P_AddToBlockCell(blockcell_t *cell, mobj_t *thing) {
+  blockthing_t *things;
+
+  if (cell->numthings == cell->maxthings) {
+    cell->maxthings = cell->maxthings ? cell->maxthings * 2 : 4;
+    things = Z_Malloc(cell->maxthings * sizeof(*things), PU_LEVEL, NULL);
+
+    if (cell->things != NULL) {
+      memcpy(things, cell->things, cell->numthings * sizeof(*things));
+      Z_Free(cell->things);
+    }
+
+    cell->things = things;
+  }
+
+  things = &cell->things[cell->numthings++];
+  things->x = thing->x;
+  things->y = thing->y;
+  things->radius = thing->radius;
+  things->mobj = thing;
+
+  blockcellchanges++;
+}
+
+static void P_RemoveFromBlockCell(blockcell_t *cell, mobj_t *thing) {
+  int i;
+
+  for (i = cell->numthings - 1; i >= 0; i--) {
+    if (cell->things[i].mobj == thing) {
+      cell->numthings--;
+      memmove(&cell->things[i], &cell->things[i + 1],
+              (cell->numthings - i) * sizeof(*cell->things));
+      blockcellchanges++;
+      return;
+    }
+  }
+}
+
 //
 // P_UnsetThingPosition
 // Unlinks a thing from block map and sectors.
@@ -305,17 +348,22 @@ void P_UnsetThingPosition(mobj_t *thing) {
     if (thing->bnext)
       thing->bnext->bprev = thing->bprev;
 
+    blockx = (thing->x - bmaporgx) >> MAPBLOCKSHIFT;
+    blocky = (thing->y - bmaporgy) >> MAPBLOCKSHIFT;
+
     if (thing->bprev)
       thing->bprev->bnext = thing->bnext;
     else {
-      blockx = (thing->x - bmaporgx) >> MAPBLOCKSHIFT;
-      blocky = (thing->y - bmaporgy) >> MAPBLOCKSHIFT;
-
       if (blockx >= 0 && blockx < bmapwidth && blocky >= 0 &&
           blocky < bmapheight) {
         blocklinks[blocky * bmapwidth + blockx] = thing->bnext;
       }
     }
+
+    if (blockx >= 0 && blockx < bmapwidth && blocky >= 0 &&
+        blocky < bmapheight) {
+      P_RemoveFromBlockCell(&blockcells[blocky * bmapwidth + blockx], thing);
+    }
   }
 }
 
@@ -364,6 +412,8 @@ void P_SetThingPosition(mobj_t *thing) {
         (*link)->bprev = thing;
 
       *link = thing;
+
+      P_AddToBlockCell(&blockcells[blocky * bmapwidth + blockx], thing);
     } else {
       // thing is off the map
       thing->bnext = thing->bprev = NULL;
@@ -389,7 +439,7 @@ void P_SetThingPosition(mobj_t *thing) {
 //
 boolean P_BlockLinesIterator(int x, int y, boolean (*func)(line_t *)) {
   int offset;
-  short *list;
+  int32_t *list;
   line_t *ld;
 
   if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight) {
@@ -414,6 +464,48 @@ boolean P_BlockLinesIterator(int x, int y, boolean (*func)(line_t *)) {
   return true; // everything was checked
 }
 
+//
+// P_BlockLinesIteratorBox
+// As P_BlockLinesIterator, but lines whose bounding box
+// misses the given one are passed over using lineboxes[]
+// alone. They are not marked, which changes nothing for
+// callers that would have ignored them anyway.
+//
+boolean P_BlockLinesIteratorBox(int x, int y, fixed_t *box,
+                                boolean (*func)(line_t *)) {
+  int offset;
+  int32_t *list;
+  fixed_t *bbox;
+  line_t *ld;
+
+  if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight) {
+    return true;
+  }
+
+  offset = y * bmapwidth + x;
+
+  offset = *(blockmap + offset);
+
+  for (list = blockmaplump + offset; *list != -1; list++) {
+    bbox = lineboxes[*list].bbox;
+
+    if (box[BOXRIGHT] <= bbox[BOXLEFT] || box[BOXLEFT] >= bbox[BOXRIGHT] ||
+        box[BOXTOP] <= bbox[BOXBOTTOM] || box[BOXBOTTOM] >= bbox[BOXTOP])
+      continue;
+
+    ld = &lines[*list];
+
+    if (ld->validcount == validcount)
+      continue; // line has already been checked
+
+    ld->validcount = validcount;
+
+    if (!func(ld))
+      return false;
+  }
+  return true; // everything was checked
+}
+
 //
 // P_BlockThingsIterator
 //
@@ -431,11 +523,64 @@ boolean P_BlockThingsIterator(int x, int y, boolean (*func)(mobj_t *)) {
   return true;
 }
 
+//
+// P_BlockThingsIteratorNear
+// As P_BlockThingsIterator, but skips things whose bounding
+// box doesn't overlap one of the given radius around nearx,
+// neary, for functions that would ignore them anyway.
+//
+boolean P_BlockThingsIteratorNear(int x, int y, fixed_t nearx, fixed_t neary,
+                                  fixed_t radius, boolean (*func)(mobj_t *)) {
+  blockcell_t *cell;
+  blockthing_t *thing;
+  mobj_t *mobj;
+  int changes;
+  int i;
+
+  if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight) {
+    return true;
+  }
+
+  cell = &blockcells[y * bmapwidth + x];
+  changes = blockcellchanges;
+
+  for (i = cell->numthings - 1; i >= 0; i--) {
+    thing = &cell->things[i];
+
+    if (abs(thing->x - nearx) >= thing->radius + radius ||
+        abs(thing->y - neary) >= thing->radius + radius) {
+      continue;
+    }
+
+    mobj = thing->mobj;
+
+    if (!func(mobj))
+      return false;
+
+    // If func moved, removed or spawned anything, carry on
+    // down the chain from here, as Vanilla Doom would have.
+    if (blockcellchanges != changes) {
+      for (mobj = mobj->bnext; mobj; mobj = mobj->bnext) {
+        if (!func(mobj))
+          return false;
+      }
+
+      return true;
+    }
+  }
+
+  return true;
+}
+
 //
 // INTERCEPT ROUTINES
 //
-intercept_t intercepts[MAXINTERCEPTS];
+intercept_t *intercepts;
 intercept_t *intercept_p;
+static int numintercepts;
+
+// Indexes into intercepts, kept as a heap by P_TraverseIntercepts.
+static int *interceptheap;
 
 divline_t trace;
 boolean earlyout;
@@ -443,6 +588,37 @@ int ptflags;
 
 static void InterceptsOverrun(int num_intercepts, intercept_t *intercept);
 
+//
+// P_CheckIntercepts
+// Make room for one more intercept.
+//
+static void P_CheckIntercepts(void) {
+  intercept_t *newintercepts;
+  int count;
+
+  count = intercept_p - intercepts;
+
+  if (count < numintercepts)
+    return;
+
+  numintercepts = numintercepts ? numintercepts * 2 : MAXINTERCEPTS;
+
+  newintercepts =
+      Z_Malloc(numintercepts * sizeof(*newintercepts), PU_STATIC, NULL);
+
+  if (intercepts != NULL) {
+    memcpy(newintercepts, intercepts, count * sizeof(*newintercepts));
+    Z_Free(intercepts);
+    Z_Free(interceptheap);
+  }
+
+  intercepts = newintercepts;
+  intercept_p = intercepts + count;
+
+  interceptheap = Z_Malloc(numintercepts * sizeof(*interceptheap), PU_STATIC,
+                           NULL);
+}
+
 //
 // PIT_AddLineIntercepts.
 // Looks for lines in the given block
@@ -484,6 +660,8 @@ boolean PIT_AddLineIntercepts(line_t *ld) {
     return false; // stop checking
   }
 
+  P_CheckIntercepts();
+
   intercept_p->frac = frac;
   intercept_p->isaline = true;
   intercept_p->d.line = ld;
@@ -544,6 +722,8 @@ boolean PIT_AddThingIntercepts(mobj_t *thing) {
   if (frac < 0)
     return true; // behind source
 
+  P_CheckIntercepts();
+
   intercept_p->frac = frac;
   intercept_p->isaline = false;
   intercept_p->d.thing = thing;
@@ -558,44 +738,69 @@ boolean PIT_AddThingIntercepts(mobj_t *thing) {
 // Returns true if the traverser function returns true
 // for all lines.
 //
+// Intercepts come out nearest first, and in the order they
+//  were added when at the same distance, as in Vanilla Doom.
+
+static boolean P_InterceptBefore(int a, int b) {
+  if (intercepts[a].frac != intercepts[b].frac)
+    return intercepts[a].frac < intercepts[b].frac;
+
+  return a < b;
+}
+
+static void P_SiftIntercept(int i, int count) {
+  int child;
+  int in;
+
+  in = interceptheap[i];
+
+  for (;;) {
+    child = i * 2 + 1;
+
+    if (child >= count)
+      break;
+
+    if (child + 1 < count &&
+        P_InterceptBefore(interceptheap[child + 1], interceptheap[child])) {
+      child++;
+    }
+
+    if (!P_InterceptBefore(interceptheap[child], in))
+      break;
+
+    interceptheap[i] = interceptheap[child];
+    i = child;
+  }
+
+  interceptheap[i] = in;
+}
+
 boolean P_TraverseIntercepts(traverser_t func, fixed_t maxfrac) {
   int count;
-  fixed_t dist;
-  intercept_t *scan;
+  int i;
   intercept_t *in;
 
   count = intercept_p - intercepts;
 
-  in = 0; // shut up compiler warning
+  // Heap them up, rather than scanning the lot for
+  // the nearest every time round.
+  for (i = 0; i < count; i++)
+    interceptheap[i] = i;
 
-  while (count--) {
-    dist = INT_MAX;
-    for (scan = intercepts; scan < intercept_p; scan++) {
-      if (scan->frac < dist) {
-        dist = scan->frac;
-        in = scan;
-      }
-    }
+  for (i = count / 2 - 1; i >= 0; i--)
+    P_SiftIntercept(i, count);
 
-    if (dist > maxfrac)
-      return true; // checked everything in range
+  while (count) {
+    in = &intercepts[interceptheap[0]];
 
-#if 0 // UNUSED
-    {
-	// don't check these yet, there may be others inserted
-	in = scan = intercepts;
-	for ( scan = intercepts ; scan<intercept_p ; scan++)
-	    if (scan->frac > maxfrac)
-		*in++ = *scan;
-	intercept_p = in;
-	return false;
-    }
-#endif
+    if (in->frac > maxfrac)
+      return true; // checked everything in range
 
     if (!func(in))
       return false; // don't bother going farther
 
-    in->frac = INT_MAX;
+    interceptheap[0] = interceptheap[--count];
+    P_SiftIntercept(0, count);
   }
 
   return true; // everything was traversed
@@ -800,11 +1005,11 @@ boolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
 
   // Step through map blocks.
   // Count is present to prevent a round off error
-  // from skipping the break.
+  // from skipping the break. Finer blocks get as far.
   mapx = xt1;
   mapy = yt1;
 
-  for (count = 0; count < 64; count++) {
+  for (count = 0; count < 64 << (FRACBITS + 7 - MAPBLOCKSHIFT); count++) {
     if (flags & PT_ADDLINES) {
       if (!P_BlockLinesIterator(mapx, mapy, PIT_AddLineIntercepts))
         return false; // early out
@@ -45,6 +45,8 @@ int test;
 boolean P_SetMobjState(mobj_t *mobj, statenum_t state) {
   state_t *st;
 
+  P_WakeThinker(&mobj->thinker);
+
   do {
     if (state == S_NULL) {
       mobj->state = (state_t *)S_NULL;
@@ -420,6 +422,26 @@ void P_MobjThinker(mobj_t *mobj) {
   }
 }
 
+//
+// P_MobjDormant
+// True if P_MobjThinker would do nothing at all with the mobj,
+//  and will go on doing nothing until something else changes
+//  its momentum, height, state or flags.
+//
+boolean P_MobjDormant(mobj_t *mobj) {
+  if (mobj->momx || mobj->momy || (mobj->flags & MF_SKULLFLY))
+    return false;
+
+  if ((mobj->z != mobj->floorz) || mobj->momz)
+    return false;
+
+  if (mobj->tics != -1)
+    return false;
+
+  // nightmare respawn counts the tics
+  return !(mobj->flags & MF_COUNTKILL) || !respawnmonsters;
+}
+
 //
 // P_SpawnMobj
 //
@@ -428,7 +450,7 @@ mobj_t *P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type) {
   state_t *st;
   mobjinfo_t *info;
 
-  mobj = Z_Malloc(sizeof(*mobj), PU_LEVEL, NULL);
+  mobj = P_AllocateThinker(sizeof(*mobj));
   memset(mobj, 0, sizeof(*mobj));
   info = &mobjinfo[type];
 
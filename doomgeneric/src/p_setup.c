@@ -18,6 +18,7 @@
 //
 
 #include <math.h>
+#include <stdlib.h>
 
 #include "z_zone.h"
 
@@ -61,6 +62,7 @@ node_t *nodes;
 
 int numlines;
 line_t *lines;
+linebox_t *lineboxes;
 
 int numsides;
 side_t *sides;
@@ -76,15 +78,18 @@ static int totallines;
 //
 // Blockmap size.
 int bmapwidth;
-int bmapheight;  // size in mapblocks
-short *blockmap; // int for larger maps
+int bmapheight;    // size in mapblocks
+int32_t *blockmap; // int for larger maps
 // offsets in blockmap are from here
-short *blockmaplump;
+int32_t *blockmaplump;
+// log2 of the block size in fixed point units
+int mapblockshift = FRACBITS + 7;
 // origin of block map
 fixed_t bmaporgx;
 fixed_t bmaporgy;
 // for thing chains
 mobj_t **blocklinks;
+blockcell_t *blockcells;
 
 // REJECT
 // For fast sight rejection.
@@ -361,6 +366,7 @@ void P_LoadLineDefs(int lump) {
   numlines = W_LumpLength(lump) / sizeof(maplinedef_t);
   lines = Z_Malloc(numlines * sizeof(line_t), PU_LEVEL, 0);
   memset(lines, 0, numlines * sizeof(line_t));
+  lineboxes = Z_Malloc(numlines * sizeof(linebox_t), PU_LEVEL, 0);
   data = W_CacheLumpNum(lump, PU_STATIC);
 
   mld = (maplinedef_t *)data;
@@ -371,6 +377,7 @@ void P_LoadLineDefs(int lump) {
     ld->tag = SHORT(mld->tag);
     v1 = ld->v1 = &vertexes[SHORT(mld->v1)];
     v2 = ld->v2 = &vertexes[SHORT(mld->v2)];
+    ld->bbox = lineboxes[i].bbox;
     ld->dx = v2->x - v1->x;
     ld->dy = v2->y - v1->y;
 
@@ -446,39 +453,296 @@ void P_LoadSideDefs(int lump) {
   W_ReleaseLumpNum(lump);
 }
 
+//
+// P_VanillaLevel
+// Demos get the level data Vanilla Doom would have had: the
+//  REJECT and BLOCKMAP lumps as they are. Only a missing or
+//  empty BLOCKMAP, which Vanilla Doom can't play, is built.
+// G_DoPlayDemo loads the first level before setting demoplayback,
+//  but with precache turned off.
+//
+static boolean P_VanillaLevel(void) {
+  return demoplayback || demorecording || !precache;
+}
+
+//
+// P_BlockMapUsable
+// Checks that every list in a BLOCKMAP lump can be reached
+//  through its 16-bit offsets, and ends inside the lump.
+//
+static boolean P_BlockMapUsable(short *data, int count) {
+  int width;
+  int height;
+  int offset;
+  int i;
+
+  // Lists past 64K words can't have been reached, so
+  // a lump that big has overflowed its offsets.
+
+  if (count < 4 || count > 0x10000)
+    return false;
+
+  width = SHORT(data[2]);
+  height = SHORT(data[3]);
+
+  if (width <= 0 || height <= 0 || 4 + width * height > count)
+    return false;
+
+  for (i = 0; i < width * height; i++) {
+    offset = (unsigned short)SHORT(data[4 + i]);
+
+    if (offset < 4 + width * height)
+      return false;
+
+    for (; offset < count && data[offset] != -1; offset++) {
+      if ((unsigned short)SHORT(data[offset]) >= numlines)
+        return false;
+    }
+
+    if (offset == count)
+      return false;
+  }
+
+  return true;
+}
+
+//
+// P_AddLineToBlocks
+// Counts a line in every block it touches, or, given lists,
+//  appends it to them, advancing each block's fill position.
+// Blocks the line only grazes are included too.
+//
+static void P_AddLineToBlocks(int linenum, int *blocks, int32_t *lists) {
+  line_t *ld;
+  int blockunits;
+  int x1, y1, x2, y2;
+  int ya, yb;
+  int xa, xb;
+  int bx, by;
+  int bxl, bxh;
+
+  ld = &lines[linenum];
+  blockunits = MAPBLOCKUNITS;
+
+  x1 = (ld->v1->x - bmaporgx) >> FRACBITS;
+  y1 = (ld->v1->y - bmaporgy) >> FRACBITS;
+  x2 = (ld->v2->x - bmaporgx) >> FRACBITS;
+  y2 = (ld->v2->y - bmaporgy) >> FRACBITS;
+
+  if (y1 > y2) {
+    xa = x1, ya = y1;
+    x1 = x2, y1 = y2;
+    x2 = xa, y2 = ya;
+  }
+
+  for (by = y1 / blockunits; by <= y2 / blockunits; by++) {
+    // Where the line crosses this row of blocks.
+
+    ya = by * blockunits > y1 ? by * blockunits : y1;
+    yb = (by + 1) * blockunits < y2 ? (by + 1) * blockunits : y2;
+
+    if (y1 == y2) {
+      xa = x1;
+      xb = x2;
+    } else {
+      xa = x1 + (int64_t)(ya - y1) * (x2 - x1) / (y2 - y1);
+      xb = x1 + (int64_t)(yb - y1) * (x2 - x1) / (y2 - y1);
+    }
+
+    // Widen by a unit to cover rounding.
+
+    bxl = ((xa < xb ? xa : xb) - 1) / blockunits;
+    bxh = ((xa > xb ? xa : xb) + 1) / blockunits;
+
+    if (bxl < 0)
+      bxl = 0;
+    if (bxh >= bmapwidth)
+      bxh = bmapwidth - 1;
+
+    for (bx = bxl; bx <= bxh; bx++) {
+      if (lists == NULL)
+        blocks[by * bmapwidth + bx]++;
+      else
+        lists[blocks[by * bmapwidth + bx]++] = linenum;
+    }
+  }
+}
+
+//
+// P_CreateBlockMap
+// Builds a blockmap covering every vertex, with 32-bit offsets.
+// Like the ones node builders make, each list starts with line 0.
+//
+static void P_CreateBlockMap(void) {
+  int minx, miny, maxx, maxy;
+  int numblocks;
+  int *blocks;
+  int offset;
+  int i;
+
+  minx = maxx = vertexes[0].x >> FRACBITS;
+  miny = maxy = vertexes[0].y >> FRACBITS;
+
+  for (i = 1; i < numvertexes; i++) {
+    if ((vertexes[i].x >> FRACBITS) < minx)
+      minx = vertexes[i].x >> FRACBITS;
+    if ((vertexes[i].x >> FRACBITS) > maxx)
+      maxx = vertexes[i].x >> FRACBITS;
+    if ((vertexes[i].y >> FRACBITS) < miny)
+      miny = vertexes[i].y >> FRACBITS;
+    if ((vertexes[i].y >> FRACBITS) > maxy)
+      maxy = vertexes[i].y >> FRACBITS;
+  }
+
+  bmaporgx = minx << FRACBITS;
+  bmaporgy = miny << FRACBITS;
+  bmapwidth = ((maxx - minx) >> MAPBTOFRAC) + 1;
+  bmapheight = ((maxy - miny) >> MAPBTOFRAC) + 1;
+  numblocks = bmapwidth * bmapheight;
+
+  // Count the lines in each block, then lay out the lists.
+
+  blocks = Z_Malloc(numblocks * sizeof(*blocks), PU_STATIC, NULL);
+  memset(blocks, 0, numblocks * sizeof(*blocks));
+
+  for (i = 0; i < numlines; i++)
+    P_AddLineToBlocks(i, blocks, NULL);
+
+  offset = 4 + numblocks;
+
+  for (i = 0; i < numblocks; i++)
+    offset += blocks[i] + 2;
+
+  blockmaplump = Z_Malloc(offset * sizeof(*blockmaplump), PU_LEVEL, NULL);
+  blockmap = blockmaplump + 4;
+
+  blockmaplump[0] = minx;
+  blockmaplump[1] = miny;
+  blockmaplump[2] = bmapwidth;
+  blockmaplump[3] = bmapheight;
+
+  offset = 4 + numblocks;
+
+  for (i = 0; i < numblocks; i++) {
+    blockmap[i] = offset;
+    blockmaplump[offset] = 0;
+    offset += blocks[i] + 2;
+    blocks[i] = blockmap[i] + 1;
+  }
+
+  for (i = 0; i < numlines; i++)
+    P_AddLineToBlocks(i, blocks, blockmaplump);
+
+  for (i = 0; i < numblocks; i++)
+    blockmaplump[blocks[i]] = -1;
+
+  Z_Free(blocks);
+}
+
 //
 // P_LoadBlockMap
+// The lump's offsets are read as unsigned, for lumps up to 64K words;
+//  anything it can't describe is rebuilt.
+// Demos get the lump as Vanilla Doom read it, signed offsets and all,
+//  unless there's no lump to read.
 //
 void P_LoadBlockMap(int lump) {
+  short *data;
+  int blockunits;
   int i;
+  int p;
   int count;
   int lumplen;
+  boolean create;
+  boolean vanilla;
+
+  mapblockshift = FRACBITS + 7;
+  create = false;
+  vanilla = P_VanillaLevel();
+
+  if (!vanilla) {
+    //!
+    // @category obscure
+    //
+    // Build blockmaps at load time, ignoring the BLOCKMAP lumps.
+    //
+
+    create = M_ParmExists("-blockmap");
+
+    //!
+    // @category obscure
+    // @arg <units>
+    //
+    // Build blockmaps with finer blocks, of 32 or 64 map units
+    // rather than 128, so fewer lines are checked per block.
+    //
+
+    p = M_CheckParmWithArgs("-blocksize", 1);
+
+    if (p > 0) {
+      blockunits = atoi(myargv[p + 1]);
+
+      if (blockunits == 32 || blockunits == 64) {
+        mapblockshift = FRACBITS + (blockunits == 32 ? 5 : 6);
+        create = true;
+      }
+    }
+  }
 
   lumplen = W_LumpLength(lump);
   count = lumplen / 2;
 
-  blockmaplump = Z_Malloc(lumplen, PU_LEVEL, NULL);
-  W_ReadLump(lump, blockmaplump);
-  blockmap = blockmaplump + 4;
+  if (count == 0 || strncasecmp(lumpinfo[lump].name, "BLOCKMAP", 8) != 0)
+    create = true;
 
-  // Swap all short integers to native byte ordering.
+  if (!create) {
+    data = W_CacheLumpNum(lump, PU_STATIC);
 
-  for (i = 0; i < count; i++) {
-    blockmaplump[i] = SHORT(blockmaplump[i]);
+    if (!vanilla && !P_BlockMapUsable(data, count)) {
+      W_ReleaseLumpNum(lump);
+      create = true;
+    }
   }
 
-  // Read the header
+  if (create) {
+    P_CreateBlockMap();
+  } else {
+    blockmaplump = Z_Malloc(count * sizeof(*blockmaplump), PU_LEVEL, NULL);
+    blockmap = blockmaplump + 4;
+
+    // Swap all short integers to native byte ordering,
+    // reading offsets and line numbers as unsigned, other
+    // than for demos.
+
+    for (i = 0; i < 4; i++)
+      blockmaplump[i] = SHORT(data[i]);
+
+    for (i = 4; i < count; i++) {
+      if (vanilla || data[i] == -1)
+        blockmaplump[i] = SHORT(data[i]);
+      else
+        blockmaplump[i] = (unsigned short)SHORT(data[i]);
+    }
+
+    W_ReleaseLumpNum(lump);
 
-  bmaporgx = blockmaplump[0] << FRACBITS;
-  bmaporgy = blockmaplump[1] << FRACBITS;
-  bmapwidth = blockmaplump[2];
-  bmapheight = blockmaplump[3];
+    // Read the header
+
+    bmaporgx = blockmaplump[0] << FRACBITS;
+    bmaporgy = blockmaplump[1] << FRACBITS;
+    bmapwidth = blockmaplump[2];
+    bmapheight = blockmaplump[3];
+  }
 
   // Clear out mobj chains
 
   count = sizeof(*blocklinks) * bmapwidth * bmapheight;
   blocklinks = Z_Malloc(count, PU_LEVEL, 0);
   memset(blocklinks, 0, count);
+
+  count = sizeof(*blockcells) * bmapwidth * bmapheight;
+  blockcells = Z_Malloc(count, PU_LEVEL, 0);
+  memset(blockcells, 0, count);
 }
 
 //
@@ -635,8 +899,383 @@ static void PadRejectArray(byte *array, unsigned int len) {
   }
 }
 
+// Directed portals through two-sided lines, used to build a
+// REJECT matrix for maps that don't come with one.
+
+typedef struct {
+  line_t *line;
+  int from;
+  int to;
+
+  // 1 when entering the front side, -1 when entering the back side.
+  int facing;
+} portal_t;
+
+// Built matrices, most recent first, keyed by a checksum of the map.
+// The matrices are PU_CACHE, so the zone can take them back when
+// it needs the room; an entry whose matrix is gone is built again.
+
+#define MAX_REJECT_CACHE 8
+
+typedef struct rejectcache_s {
+  unsigned int checksum;
+  int numsectors;
+  byte *matrix;
+  struct rejectcache_s *next;
+} rejectcache_t;
+
+static rejectcache_t *rejectcache;
+
+// Give up on maps that take more than this many portal steps.
+
+#define MAX_REJECT_WORK 100000000
+
+//
+// P_PortalSide
+// Which side of the portal's line a point, in fixed point, is on:
+// above zero for the side being entered, below zero for the
+// side being left, zero for exactly on the line.
+// Vertexes are whole map units (see P_LoadVertexes), so the
+// line's dx and dy are exact in map units, which keeps the
+// cross product exact and well inside 64 bits.
+//
+static int64_t P_PortalSide(portal_t *portal, int64_t x, int64_t y) {
+  line_t *line = portal->line;
+  int64_t dx = line->dx >> FRACBITS;
+  int64_t dy = line->dy >> FRACBITS;
+
+  // Below zero is the front side, as in P_PointOnLineSide.
+  return ((y - line->v1->y) * dx - (x - line->v1->x) * dy) * -portal->facing;
+}
+
+//
+// P_CanStepPortal
+// A straight line that crosses portal "from" and then portal
+// "to" crosses "to" on the entered side of "from", having
+// started on the side of "to" being left, as did the whole
+// line back to its start in "box". Anything failing that
+// can't be on such a line. Points exactly on a line count as
+// being on either side of it, so touching is never rejected.
+//
+static boolean P_CanStepPortal(portal_t *from, portal_t *to, int64_t *box) {
+  line_t *toline = to->line;
+  line_t *fromline = from->line;
+
+  if (P_PortalSide(from, toline->v1->x, toline->v1->y) < 0 &&
+      P_PortalSide(from, toline->v2->x, toline->v2->y) < 0) {
+    return false;
+  }
+
+  if (P_PortalSide(to, fromline->v1->x, fromline->v1->y) > 0 &&
+      P_PortalSide(to, fromline->v2->x, fromline->v2->y) > 0) {
+    return false;
+  }
+
+  return P_PortalSide(to, box[BOXLEFT], box[BOXTOP]) <= 0 ||
+         P_PortalSide(to, box[BOXRIGHT], box[BOXTOP]) <= 0 ||
+         P_PortalSide(to, box[BOXLEFT], box[BOXBOTTOM]) <= 0 ||
+         P_PortalSide(to, box[BOXRIGHT], box[BOXBOTTOM]) <= 0;
+}
+
+//
+// P_SectorClosed
+// True if the sector's lines make closed loops, so that
+// there's no way out of it but across one of them.
+//
+static boolean P_SectorClosed(sector_t *sector) {
+  int i, j;
+  int count;
+  vertex_t *v;
+
+  for (i = 0; i < sector->linecount; i++) {
+    // Lines with this sector on both sides don't bound it
+    if (sector->lines[i]->frontsector == sector->lines[i]->backsector)
+      continue;
+
+    v = sector->lines[i]->v1;
+    count = 0;
+
+    for (j = 0; j < sector->linecount; j++) {
+      if (sector->lines[j]->frontsector == sector->lines[j]->backsector)
+        continue;
+
+      count += sector->lines[j]->v1 == v;
+      count += sector->lines[j]->v2 == v;
+    }
+
+    if (count & 1)
+      return false;
+  }
+
+  return true;
+}
+
+static unsigned int P_MapChecksum(void) {
+  unsigned int sum = 2166136261u;
+  int values[6];
+  int i, j;
+
+  for (i = 0; i < numlines; i++) {
+    values[0] = lines[i].v1->x;
+    values[1] = lines[i].v1->y;
+    values[2] = lines[i].v2->x;
+    values[3] = lines[i].v2->y;
+    values[4] = lines[i].frontsector - sectors;
+    values[5] = lines[i].backsector ? lines[i].backsector - sectors : -1;
+
+    for (j = 0; j < 6; j++)
+      sum = (sum ^ values[j]) * 16777619;
+  }
+
+  return (sum ^ numsectors) * 16777619;
+}
+
+//
+// P_BuildReject
+// Fill in a zeroed REJECT matrix from the map geometry.
+// A pair of sectors is only rejected when no straight line
+// from one to the other can pass through the two-sided lines
+// between them, whatever the sector heights. Sight lines start
+// at a mobj's centre, which can be pushed a little way outside
+// its sector's lines, so each sector's bounding box is grown by
+// MAXRADIUS before it's used as where lines start.
+//
+static void P_BuildReject(byte *matrix) {
+  portal_t *portals;
+  int *firstportal;
+  int *stamps;
+  int *queue;
+  int64_t (*boxes)[4];
+  byte *seen;
+  boolean *closed;
+  rejectcache_t *cache, **prev;
+  unsigned int checksum;
+  int numportals;
+  int head, tail;
+  int work;
+  int a, b, i, j, p;
+  int length;
+
+  length = (numsectors * numsectors + 7) / 8;
+  checksum = P_MapChecksum();
+
+  for (cache = rejectcache, prev = &rejectcache; cache != NULL;
+       prev = &cache->next, cache = cache->next) {
+    if (cache->checksum == checksum && cache->numsectors == numsectors &&
+        cache->matrix != NULL) {
+      memcpy(matrix, cache->matrix, length);
+
+      // Move to the front
+      *prev = cache->next;
+      cache->next = rejectcache;
+      rejectcache = cache;
+      return;
+    }
+  }
+
+  // Portals, grouped by the sector they lead out of.
+
+  firstportal = Z_Malloc((numsectors + 1) * sizeof(*firstportal), PU_STATIC, 0);
+  memset(firstportal, 0, (numsectors + 1) * sizeof(*firstportal));
+
+  numportals = 0;
+
+  for (i = 0; i < numlines; i++) {
+    if (lines[i].backsector != NULL) {
+      firstportal[lines[i].frontsector - sectors + 1]++;
+      firstportal[lines[i].backsector - sectors + 1]++;
+      numportals += 2;
+    }
+  }
+
+  for (a = 0; a < numsectors; a++)
+    firstportal[a + 1] += firstportal[a];
+
+  portals = Z_Malloc(numportals * sizeof(*portals), PU_STATIC, 0);
+  stamps = Z_Malloc(numportals * sizeof(*stamps), PU_STATIC, 0);
+  queue = Z_Malloc(numportals * sizeof(*queue), PU_STATIC, 0);
+
+  for (i = 0; i < numlines; i++) {
+    if (lines[i].backsector != NULL) {
+      a = lines[i].frontsector - sectors;
+      b = lines[i].backsector - sectors;
+
+      p = firstportal[a]++;
+      portals[p].line = &lines[i];
+      portals[p].from = a;
+      portals[p].to = b;
+      portals[p].facing = -1;
+
+      p = firstportal[b]++;
+      portals[p].line = &lines[i];
+      portals[p].from = b;
+      portals[p].to = a;
+      portals[p].facing = 1;
+    }
+  }
+
+  // Filling in moved each start along to the next sector's.
+
+  for (a = numsectors; a > 0; a--)
+    firstportal[a] = firstportal[a - 1];
+
+  firstportal[0] = 0;
+
+  // Sector bounding boxes, grown by MAXRADIUS.
+
+  boxes = Z_Malloc(numsectors * sizeof(*boxes), PU_STATIC, 0);
+  closed = Z_Malloc(numsectors * sizeof(*closed), PU_STATIC, 0);
+
+  for (a = 0; a < numsectors; a++) {
+    fixed_t bbox[4];
+
+    M_ClearBox(bbox);
+
+    for (j = 0; j < sectors[a].linecount; j++) {
+      M_AddToBox(bbox, sectors[a].lines[j]->v1->x, sectors[a].lines[j]->v1->y);
+      M_AddToBox(bbox, sectors[a].lines[j]->v2->x, sectors[a].lines[j]->v2->y);
+    }
+
+    boxes[a][BOXTOP] = (int64_t)bbox[BOXTOP] + MAXRADIUS;
+    boxes[a][BOXBOTTOM] = (int64_t)bbox[BOXBOTTOM] - MAXRADIUS;
+    boxes[a][BOXLEFT] = (int64_t)bbox[BOXLEFT] - MAXRADIUS;
+    boxes[a][BOXRIGHT] = (int64_t)bbox[BOXRIGHT] + MAXRADIUS;
+
+    closed[a] = P_SectorClosed(&sectors[a]);
+  }
+
+  // Flood out of each sector in turn, through every portal
+  // a straight line could go on through.
+
+  seen = Z_Malloc(length, PU_STATIC, 0);
+  memset(seen, 0, length);
+  memset(stamps, 0, numportals * sizeof(*stamps));
+
+  work = 0;
+
+  for (a = 0; a < numsectors && work < MAX_REJECT_WORK; a++) {
+    seen[(a * numsectors + a) >> 3] |= 1 << ((a * numsectors + a) & 7);
+
+    head = tail = 0;
+
+    for (p = firstportal[a]; p < firstportal[a + 1]; p++) {
+      stamps[p] = a + 1;
+      queue[tail++] = p;
+    }
+
+    while (head < tail) {
+      portal_t *from = &portals[queue[head++]];
+
+      b = a * numsectors + from->to;
+      seen[b >> 3] |= 1 << (b & 7);
+
+      for (p = firstportal[from->to]; p < firstportal[from->to + 1]; p++) {
+        work++;
+
+        if (stamps[p] != a + 1 && portals[p].line != from->line &&
+            P_CanStepPortal(from, &portals[p], boxes[a])) {
+          stamps[p] = a + 1;
+          queue[tail++] = p;
+        }
+      }
+    }
+  }
+
+  if (work < MAX_REJECT_WORK) {
+    for (a = 0; a < numsectors; a++) {
+      for (b = 0; b < numsectors; b++) {
+        i = a * numsectors + b;
+        j = b * numsectors + a;
+
+        // Unclosed sectors can see out of their gaps.
+        if (!closed[a] || !closed[b] || (seen[i >> 3] & (1 << (i & 7))) ||
+            (seen[j >> 3] & (1 << (j & 7)))) {
+          continue;
+        }
+
+        matrix[i >> 3] |= 1 << (i & 7);
+      }
+    }
+
+    // Keep it for next time, dropping the oldest.
+
+    cache = Z_Malloc(sizeof(*cache), PU_STATIC, 0);
+    cache->checksum = checksum;
+    cache->numsectors = numsectors;
+    Z_Malloc(length, PU_CACHE, &cache->matrix);
+    memcpy(cache->matrix, matrix, length);
+    cache->next = rejectcache;
+    rejectcache = cache;
+
+    for (i = 0, prev = &rejectcache; *prev != NULL; i++) {
+      if (i == MAX_REJECT_CACHE) {
+        if ((*prev)->matrix != NULL)
+          Z_Free((*prev)->matrix);
+        Z_Free(*prev);
+        *prev = NULL;
+      } else {
+        prev = &(*prev)->next;
+      }
+    }
+  } else {
+    printf("P_BuildReject: map too large, using an empty REJECT\n");
+  }
+
+  Z_Free(seen);
+  Z_Free(closed);
+  Z_Free(boxes);
+  Z_Free(queue);
+  Z_Free(stamps);
+  Z_Free(portals);
+  Z_Free(firstportal);
+}
+
+//
+// P_CheckReject
+// Build a REJECT matrix for a map that comes with its own,
+// and report every pair of sectors the built one rejects but
+// the map's allows. The map's node builder only rejected pairs
+// that can't see each other, so any such pair is one where
+// P_BuildReject would cut a sight line that's really there.
+//
+
+#define MAXREJECTREPORTS 10
+
+static void P_CheckReject(void) {
+  byte *built;
+  int length;
+  int pairs;
+  int i;
+
+  length = (numsectors * numsectors + 7) / 8;
+  built = Z_Malloc(length, PU_STATIC, 0);
+  memset(built, 0, length);
+  P_BuildReject(built);
+
+  pairs = 0;
+
+  for (i = 0; i < numsectors * numsectors; i++) {
+    if ((built[i >> 3] & (1 << (i & 7))) == 0 ||
+        (rejectmatrix[i >> 3] & (1 << (i & 7))) != 0) {
+      continue;
+    }
+
+    if (pairs < MAXREJECTREPORTS) {
+      printf("P_CheckReject: sectors %i and %i are only rejected by the "
+             "built REJECT\n",
+             i / numsectors, i % numsectors);
+    }
+
+    pairs++;
+  }
+
+  printf("P_CheckReject: %i pairs only rejected by the built REJECT\n", pairs);
+  Z_Free(built);
+}
+
 static void P_LoadReject(int lumpnum) {
   int minlength;
+  int i;
   int lumplen;
 
   // Calculate the size that the REJECT lump *should* be.
@@ -657,6 +1296,48 @@ static void P_LoadReject(int lumpnum) {
 
     PadRejectArray(rejectmatrix + lumplen, minlength - lumplen);
   }
+
+  // Most node builders leave REJECT all zeroes, so that
+  // every sight check goes all the way through the BSP.
+  // Build a real one instead, unless a demo is involved:
+  // those get exactly what Vanilla Doom would have had.
+
+  for (i = 0; i < lumplen && i < minlength; i++) {
+    if (rejectmatrix[i] != 0)
+      break;
+  }
+
+  if (i < lumplen && i < minlength) {
+    //!
+    // @category obscure
+    //
+    // For maps that come with a REJECT matrix, build one anyway
+    // and report every pair of sectors it rejects that the map's
+    // own matrix doesn't.
+    //
+
+    if (M_CheckParm("-checkreject"))
+      P_CheckReject();
+
+    return;
+  }
+
+  //!
+  // @category obscure
+  //
+  // Don't build a REJECT matrix for maps with an empty one.
+  //
+
+  if (P_VanillaLevel() || M_CheckParm("-nobuildreject")) {
+    return;
+  }
+
+  if (lumplen >= minlength) {
+    rejectmatrix = Z_Malloc(minlength, PU_LEVEL, &rejectmatrix);
+  }
+
+  memset(rejectmatrix, 0, minlength);
+  P_BuildReject(rejectmatrix);
 }
 
 //
@@ -704,12 +1385,13 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill) {
   leveltime = 0;
 
   // note: most of this ordering is important
-  P_LoadBlockMap(lumpnum + ML_BLOCKMAP);
   P_LoadVertexes(lumpnum + ML_VERTEXES);
   P_LoadSectors(lumpnum + ML_SECTORS);
   P_LoadSideDefs(lumpnum + ML_SIDEDEFS);
 
   P_LoadLineDefs(lumpnum + ML_LINEDEFS);
+  // the blockmap may have to be built from the lines
+  P_LoadBlockMap(lumpnum + ML_BLOCKMAP);
   P_LoadSubsectors(lumpnum + ML_SSECTORS);
   P_LoadNodes(lumpnum + ML_NODES);
   P_LoadSegs(lumpnum + ML_SEGS);
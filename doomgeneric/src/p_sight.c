@@ -35,7 +35,36 @@ divline_t strace; // from t1 to t2
 fixed_t t2x;
 fixed_t t2y;
 
-int sightcounts[2];
+// Rejected by REJECT, traced through the BSP, and answered
+//  from the cache below.
+int sightcounts[3];
+
+//
+// Sight checks already made this tic.
+// The same pair of things is often checked more than once in
+//  a tic, by A_Look, A_Chase and P_CheckMissileRange. The answer
+//  only depends on where the two things are and on sector
+//  heights, so it can be reused until either changes.
+//
+#define SIGHTCACHESIZE 256
+
+typedef struct {
+  mobj_t *t1;
+  mobj_t *t2;
+  fixed_t t1x, t1y, t1z, t1height;
+  fixed_t t2x, t2y, t2z, t2height;
+  subsector_t *t1subsector;
+  subsector_t *t2subsector;
+  int stamp;
+  boolean result;
+} sightcache_t;
+
+static sightcache_t sightcache[SIGHTCACHESIZE];
+
+// Entries from before the last P_ClearSightCache don't match.
+static int sightstamp = 1;
+
+void P_ClearSightCache(void) { sightstamp++; }
 
 //
 // P_DivlineSide
@@ -275,6 +304,7 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2) {
   int pnum;
   int bytenum;
   int bitnum;
+  sightcache_t *cache;
 
   // First check for trivial rejection.
 
@@ -293,6 +323,20 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2) {
     return false;
   }
 
+  // Already checked this tic?
+  cache = &sightcache[(((uintptr_t)t1 >> 4) * 31 + ((uintptr_t)t2 >> 4)) &
+                      (SIGHTCACHESIZE - 1)];
+
+  if (cache->stamp == sightstamp && cache->t1 == t1 && cache->t2 == t2 &&
+      cache->t1x == t1->x && cache->t1y == t1->y && cache->t1z == t1->z &&
+      cache->t1height == t1->height && cache->t2x == t2->x &&
+      cache->t2y == t2->y && cache->t2z == t2->z &&
+      cache->t2height == t2->height && cache->t1subsector == t1->subsector &&
+      cache->t2subsector == t2->subsector) {
+    sightcounts[2]++;
+    return cache->result;
+  }
+
   // An unobstructed LOS is possible.
   // Now look from eyes of t1 to any part of t2.
   sightcounts[1]++;
@@ -310,6 +354,22 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2) {
   strace.dx = t2->x - t1->x;
   strace.dy = t2->y - t1->y;
 
+  cache->t1 = t1;
+  cache->t2 = t2;
+  cache->t1x = t1->x;
+  cache->t1y = t1->y;
+  cache->t1z = t1->z;
+  cache->t1height = t1->height;
+  cache->t2x = t2->x;
+  cache->t2y = t2->y;
+  cache->t2z = t2->z;
+  cache->t2height = t2->height;
+  cache->t1subsector = t1->subsector;
+  cache->t2subsector = t2->subsector;
+  cache->stamp = sightstamp;
+
   // the head node is the last node output
-  return P_CrossBSPNode(numnodes - 1);
+  cache->result = P_CrossBSPNode(numnodes - 1);
+
+  return cache->result;
 }
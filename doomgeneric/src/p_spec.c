@@ -167,6 +167,31 @@ void P_InitPicAnims(void) {
   }
 }
 
+//
+// P_MarkAnimatedTextures
+// Used by R_PrecacheLevel.
+//
+void P_MarkAnimatedTextures(char *texturepresent) {
+  anim_t *anim;
+  int i;
+
+  for (anim = anims; anim < lastanim; anim++) {
+    if (!anim->istexture)
+      continue;
+
+    for (i = anim->basepic; i <= anim->picnum; i++) {
+      if (texturepresent[i])
+        break;
+    }
+
+    if (i > anim->picnum)
+      continue;
+
+    for (i = anim->basepic; i <= anim->picnum; i++)
+      texturepresent[i] = 1;
+  }
+}
+
 //
 // UTILITIES
 //
@@ -362,12 +387,66 @@ fixed_t P_FindHighestCeilingSurrounding(sector_t *sec) {
   return height;
 }
 
+//
+// Tag lists, built by P_SpawnSpecials.
+// A hash table from each tag to the first sector with it,
+//  and for each sector, the next sector with the same tag.
+//
+static short *tagkeys;
+static int *tagfirstsector;
+static int tagtablesize;
+static int *sectortagnext;
+
+static int *P_TagSlot(int tag) {
+  int i;
+
+  i = (tag * 0x9e3779b1u) & (tagtablesize - 1);
+
+  while (tagfirstsector[i] >= 0 && tagkeys[i] != tag)
+    i = (i + 1) & (tagtablesize - 1);
+
+  return &tagfirstsector[i];
+}
+
+static void P_InitTagLists(void) {
+  int *slot;
+  int i;
+
+  for (tagtablesize = 1; tagtablesize < numsectors * 2; tagtablesize <<= 1)
+    ;
+
+  tagkeys = Z_Malloc(tagtablesize * sizeof(*tagkeys), PU_LEVEL, &tagkeys);
+  tagfirstsector = Z_Malloc(tagtablesize * sizeof(*tagfirstsector), PU_LEVEL,
+                            &tagfirstsector);
+  sectortagnext = Z_Malloc(numsectors * sizeof(*sectortagnext), PU_LEVEL,
+                           &sectortagnext);
+
+  for (i = 0; i < tagtablesize; i++)
+    tagfirstsector[i] = -1;
+
+  // Backwards, so each list comes out in sector order.
+  for (i = numsectors - 1; i >= 0; i--) {
+    slot = P_TagSlot(sectors[i].tag);
+    tagkeys[slot - tagfirstsector] = sectors[i].tag;
+    sectortagnext[i] = *slot;
+    *slot = i;
+  }
+}
+
 //
 // RETURN NEXT SECTOR # THAT LINE TAG REFERS TO
 //
 int P_FindSectorFromLineTag(line_t *line, int start) {
   int i;
 
+  if (sectortagnext != NULL) {
+    if (start < 0)
+      return *P_TagSlot(line->tag);
+
+    if (start < numsectors && sectors[start].tag == line->tag)
+      return sectortagnext[start];
+  }
+
   for (i = start + 1; i < numsectors; i++)
     if (sectors[i].tag == line->tag)
       return i;
@@ -1181,7 +1260,7 @@ int EV_DoDonut(line_t *line) {
       }
 
       //	Spawn rising slime
-      floor = Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+      floor = P_AllocateThinker(sizeof(*floor));
       P_AddThinker(&floor->thinker);
       s2->specialdata = floor;
       floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -1195,7 +1274,7 @@ int EV_DoDonut(line_t *line) {
       floor->floordestheight = s3_floorheight;
 
       //	Spawn lowering donut-hole
-      floor = Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+      floor = P_AllocateThinker(sizeof(*floor));
       P_AddThinker(&floor->thinker);
       s1->specialdata = floor;
       floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -1237,6 +1316,8 @@ void P_SpawnSpecials(void) {
     levelTimer = false;
   }
 
+  P_InitTagLists();
+
   //	Init special SECTORs.
   sector = sectors;
   for (i = 0; i < numsectors; i++, sector++) {
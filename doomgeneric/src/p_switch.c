@@ -135,6 +135,21 @@ void P_InitSwitchList(void) {
   }
 }
 
+//
+// P_MarkSwitchTextures
+// Used by R_PrecacheLevel.
+//
+void P_MarkSwitchTextures(char *texturepresent) {
+  int i;
+
+  for (i = 0; i < numswitches * 2; i += 2) {
+    if (texturepresent[switchlist[i]] || texturepresent[switchlist[i + 1]]) {
+      texturepresent[switchlist[i]] = 1;
+      texturepresent[switchlist[i + 1]] = 1;
+    }
+  }
+}
+
 //
 // Start a button counting down till it turns off.
 //
@@ -17,6 +17,10 @@
 //	Thinker, Ticker.
 //
 
+#include <string.h>
+
+#include "i_system.h"
+#include "m_argv.h"
 #include "z_zone.h"
 #include "p_local.h"
 
@@ -26,7 +30,7 @@ int leveltime;
 
 //
 // THINKERS
-// All thinkers should be allocated by Z_Malloc
+// All thinkers should be allocated by P_AllocateThinker
 // so they can be operated on uniformly.
 // The actual structures will vary in size,
 // but the first element must be thinker_t.
@@ -38,7 +42,10 @@ thinker_t thinkercap;
 //
 // P_InitThinkers
 //
-void P_InitThinkers(void) { thinkercap.prev = thinkercap.next = &thinkercap; }
+void P_InitThinkers(void) {
+  thinkercap.prev = thinkercap.next = &thinkercap;
+  thinkercap.activeprev = thinkercap.activenext = &thinkercap;
+}
 
 //
 // P_AddThinker
@@ -49,6 +56,11 @@ void P_AddThinker(thinker_t *thinker) {
   thinker->next = &thinkercap;
   thinker->prev = thinkercap.prev;
   thinkercap.prev = thinker;
+
+  thinkercap.activeprev->activenext = thinker;
+  thinker->activenext = &thinkercap;
+  thinker->activeprev = thinkercap.activeprev;
+  thinkercap.activeprev = thinker;
 }
 
 //
@@ -59,35 +71,264 @@ void P_AddThinker(thinker_t *thinker) {
 void P_RemoveThinker(thinker_t *thinker) {
   // FIXME: NOP.
   thinker->function.acv = (actionf_v)(-1);
+
+  P_WakeThinker(thinker);
+}
+
+//
+// P_WakeThinker
+// Puts a dormant thinker back among the active ones,
+//  in its place in the thinker list.
+//
+void P_WakeThinker(thinker_t *thinker) {
+  thinker_t *prev;
+
+  if (thinker->activenext != NULL)
+    return;
+
+  for (prev = thinker->prev; prev->activenext == NULL; prev = prev->prev)
+    ;
+
+  thinker->activeprev = prev;
+  thinker->activenext = prev->activenext;
+  prev->activenext->activeprev = thinker;
+  prev->activenext = thinker;
+}
+
+static void P_SleepThinker(thinker_t *thinker) {
+  thinker->activeprev->activenext = thinker->activenext;
+  thinker->activenext->activeprev = thinker->activeprev;
+  thinker->activeprev = thinker->activenext = NULL;
+}
+
+//
+// THINKER POOLS
+// Thinkers of each size come from a pool carved out of
+//  level-lifetime slabs, so missiles, puffs and blood
+//  don't churn the zone every tic. Each thinker is preceded
+//  by a pointer to its pool, or to the next free one, or
+//  NULL if it came straight from the zone.
+//
+
+#define MAXTHINKERPOOLS 16
+#define THINKERSPERSLAB 64
+
+typedef struct {
+  int size;
+
+  // The first slab, set back to NULL by the zone when the
+  // level's memory is freed, taking the free list with it.
+  void *slab;
+
+  void **freelist;
+} thinkerpool_t;
+
+static thinkerpool_t thinkerpools[MAXTHINKERPOOLS];
+static int numthinkerpools;
+
+static thinkerpool_t *P_ThinkerPool(int size) {
+  thinkerpool_t *pool;
+
+  for (pool = thinkerpools; pool < thinkerpools + numthinkerpools; pool++) {
+    if (pool->size == size)
+      return pool;
+  }
+
+  if (numthinkerpools == MAXTHINKERPOOLS)
+    I_Error("P_ThinkerPool: too many thinker sizes");
+
+  pool = &thinkerpools[numthinkerpools++];
+  pool->size = size;
+  pool->slab = NULL;
+  pool->freelist = NULL;
+
+  return pool;
 }
 
 //
 // P_AllocateThinker
-// Allocates memory and adds a new thinker at the end of the list.
+// Allocates level memory for a thinker of the given size.
 //
-void P_AllocateThinker(thinker_t *thinker) {}
+void *P_AllocateThinker(int size) {
+  static int nothinkerpool = -1;
+  thinkerpool_t *pool;
+  byte *slab;
+  void **block;
+  int stride;
+  int i;
+
+  //!
+  // @category obscure
+  //
+  // Allocate each thinker from the zone, as Vanilla Doom did,
+  // e.g. to compare zone operations per tic with -timedemo.
+  //
+
+  if (nothinkerpool < 0)
+    nothinkerpool = M_ParmExists("-nothinkerpool");
+
+  if (nothinkerpool) {
+    block = Z_Malloc(sizeof(void *) + size, PU_LEVEL, NULL);
+    *block = NULL;
+    return block + 1;
+  }
+
+  pool = P_ThinkerPool(size);
+
+  if (pool->slab == NULL)
+    pool->freelist = NULL;
+
+  if (pool->freelist == NULL) {
+    stride = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    stride += sizeof(void *);
+    slab = Z_Malloc(stride * THINKERSPERSLAB, PU_LEVEL,
+                    pool->slab == NULL ? &pool->slab : NULL);
+
+    for (i = THINKERSPERSLAB - 1; i >= 0; i--) {
+      block = (void **)(slab + i * stride);
+      *block = pool->freelist;
+      pool->freelist = block;
+    }
+  }
+
+  block = pool->freelist;
+  pool->freelist = *block;
+  *block = pool;
+
+  return block + 1;
+}
 
 //
-// P_RunThinkers
+// P_DeallocateThinker
+// Gives a thinker's memory back to its pool.
 //
-void P_RunThinkers(void) {
+void P_DeallocateThinker(void *thinker) {
+  void **block;
+  thinkerpool_t *pool;
+
+  block = (void **)thinker - 1;
+  pool = *block;
+
+  // Not from a pool (see -nothinkerpool)
+  if (pool == NULL) {
+    Z_Free(block);
+    return;
+  }
+
+  *block = pool->freelist;
+  pool->freelist = block;
+}
+
+static boolean P_ThinkerDormant(thinker_t *thinker) {
+  return thinker->function.acp1 == (actionf_p1)P_MobjThinker &&
+         P_MobjDormant((mobj_t *)thinker);
+}
+
+static void P_FreeThinker(thinker_t *thinker) {
+  thinker->next->prev = thinker->prev;
+  thinker->prev->next = thinker->next;
+
+  if (thinker->activenext != NULL)
+    P_SleepThinker(thinker);
+
+  P_DeallocateThinker(thinker);
+}
+
+//
+// P_CheckDormantThinkers
+// Runs every thinker, as Vanilla Doom did, checking that the
+//  dormant ones really are still dormant, and that running
+//  them changes nothing, not even the random number index.
+//
+static void P_CheckDormantThinkers(void) {
+  extern int prndindex;
   thinker_t *currentthinker;
+  thinker_t *next;
+  mobj_t before;
+  int randomindex;
 
   currentthinker = thinkercap.next;
   while (currentthinker != &thinkercap) {
+    next = currentthinker->next;
+
     if (currentthinker->function.acv == (actionf_v)(-1)) {
       // time to remove it
-      currentthinker->next->prev = currentthinker->prev;
-      currentthinker->prev->next = currentthinker->next;
-      Z_Free(currentthinker);
+      P_FreeThinker(currentthinker);
+      currentthinker = next;
+      continue;
+    } else if (currentthinker->activenext == NULL ||
+               P_ThinkerDormant(currentthinker)) {
+      if (!P_ThinkerDormant(currentthinker)) {
+        I_Error("P_CheckDormantThinkers: thinker woke up unnoticed");
+      }
+
+      if (currentthinker->activenext != NULL)
+        P_SleepThinker(currentthinker);
+
+      before = *(mobj_t *)currentthinker;
+      randomindex = prndindex;
+
+      currentthinker->function.acp1(currentthinker);
+
+      if (memcmp(&before.thinker + 1, (thinker_t *)currentthinker + 1,
+                 sizeof(before) - sizeof(before.thinker)) != 0 ||
+          prndindex != randomindex || currentthinker->next != next) {
+        I_Error("P_CheckDormantThinkers: dormant thinker did something");
+      }
     } else {
       if (currentthinker->function.acp1)
         currentthinker->function.acp1(currentthinker);
     }
+
     currentthinker = currentthinker->next;
   }
 }
 
+//
+// P_RunThinkers
+// Mobjs that wouldn't do anything are set aside until
+//  something happens to them.
+//
+void P_RunThinkers(void) {
+  static int checkdormant = -1;
+  thinker_t *currentthinker;
+  thinker_t *next;
+
+  //!
+  // @category obscure
+  //
+  // Run dormant thinkers anyway, checking that they do nothing.
+  //
+
+  if (checkdormant < 0)
+    checkdormant = M_ParmExists("-checkdormant");
+
+  if (checkdormant) {
+    P_CheckDormantThinkers();
+    return;
+  }
+
+  currentthinker = thinkercap.activenext;
+  while (currentthinker != &thinkercap) {
+    if (currentthinker->function.acv == (actionf_v)(-1)) {
+      // time to remove it
+      next = currentthinker->activenext;
+      P_FreeThinker(currentthinker);
+      currentthinker = next;
+    } else if (P_ThinkerDormant(currentthinker)) {
+      // nothing to do until woken up
+      next = currentthinker->activenext;
+      P_SleepThinker(currentthinker);
+      currentthinker = next;
+    } else {
+      if (currentthinker->function.acp1)
+        currentthinker->function.acp1(currentthinker);
+
+      currentthinker = currentthinker->activenext;
+    }
+  }
+}
+
 //
 // P_Ticker
 //
@@ -95,6 +336,9 @@ void P_RunThinkers(void) {
 void P_Ticker(void) {
   int i;
 
+  // Sight checks from the last tic are out of date.
+  P_ClearSightCache();
+
   // run the tic
   if (paused)
     return;
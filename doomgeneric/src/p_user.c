@@ -44,6 +44,8 @@ boolean onground;
 void P_Thrust(player_t *player, angle_t angle, fixed_t move) {
   angle >>= ANGLETOFINESHIFT;
 
+  P_WakeThinker(&player->mo->thinker);
+
   player->mo->momx += FixedMul(move, finecosine[angle]);
   player->mo->momy += FixedMul(move, finesine[angle]);
 }
@@ -25,6 +25,7 @@
 #include "r_main.h"
 #include "r_plane.h"
 #include "r_things.h"
+#include "r_coherence.h"
 
 // State.
 #include "doomstat.h"
@@ -250,6 +251,8 @@ void R_AddLine(seg_t *line) {
     angle2 = -clipangle;
   }
 
+  R_MarkLineSeen(line);
+
   // The seg is in the view range,
   // but not necessarily visible.
   angle1 = (angle1 + ANG90) >> ANGLETOFINESHIFT;
@@ -429,6 +432,7 @@ void R_Subsector(int num) {
   sub = &subsectors[num];
   frontsector = sub->sector;
   count = sub->numlines;
+  R_MarkSectorSeen(frontsector);
   line = &segs[sub->firstline];
 
   if (frontsector->floorheight < viewz) {
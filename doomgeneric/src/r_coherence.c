@@ -0,0 +1,378 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Reuse of the last drawn view when nothing in it has changed.
+//	While the view is drawn, every sector and sidedef that the
+//	 BSP traversal reaches is recorded. Afterwards a checksum of
+//	 each of them (heights, flats, light, textures, offsets and
+//	 the things in each sector) is taken, along with the view
+//	 position and the player's weapon sprites.
+//	Saving the view pixels costs a copy of the whole view, so
+//	 once a saved view goes unused, views stop being saved
+//	 until one is drawn with the same checksums as the one
+//	 before it, i.e. until saving it would have paid off.
+//	The next frame, if all of that checks out the same, the
+//	 saved pixels are put back instead of drawing the view.
+//	Anything drawn with the fuzz effect changes every frame,
+//	 so a view holding any is never reused.
+//
+
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomgeneric.h"
+
+#include "i_video.h"
+#include "m_argv.h"
+#include "z_zone.h"
+
+#include "p_local.h"
+#include "r_local.h"
+#include "r_sky.h"
+#include "r_coherence.h"
+
+// Sectors and sidedefs seen in the last drawn view, and
+//  their checksums. These are PU_LEVEL, so they are gone,
+//  and nothing is reused, after a level change.
+static sector_t **seensectors;
+static side_t **seensides;
+static unsigned int *sectorsums;
+static unsigned int *sidesums;
+static int numseensectors;
+static int numseensides;
+
+// Marks for the sectors and sidedefs already in the lists,
+//  valid when equal to seenstamp.
+static int *sectorstamps;
+static int *sidestamps;
+static int seenstamp;
+
+// Everything else the view depends on.
+static unsigned int viewsum;
+
+// Whether the view above can be reused at all.
+static boolean viewkept;
+
+// All the checksums of the last drawn view together, to tell
+//  when the view drawn after it was the same.
+static unsigned int lastframesum;
+
+// Whether saving views pays off: the last saved view was put
+//  back, or the last drawn view was the same as the one before.
+static boolean keepingpays;
+
+// Whether the saved view was saved when it had just changed,
+//  and hasn't been put back yet.
+static boolean keptchangedview;
+
+// The view window pixels.
+#ifdef TRUECOLOR
+static uint32_t savedview[DOOMGENERIC_RESX * DOOMGENERIC_RESY];
+#else
+static byte savedview[SCREENWIDTH * SCREENHEIGHT];
+#endif
+
+static unsigned int R_Sum(unsigned int sum, unsigned int value) {
+  // FNV-1a, one int at a time
+  return (sum ^ value) * 16777619;
+}
+
+//
+// R_SectorSum
+// Returns 0 for a sector holding something
+//  drawn with the fuzz effect.
+//
+static unsigned int R_SectorSum(sector_t *sector) {
+  unsigned int sum;
+  mobj_t *thing;
+
+  sum = 2166136261u;
+  sum = R_Sum(sum, sector->floorheight);
+  sum = R_Sum(sum, sector->ceilingheight);
+  sum = R_Sum(sum, flattranslation[sector->floorpic]);
+  sum = R_Sum(sum, flattranslation[sector->ceilingpic]);
+  sum = R_Sum(sum, sector->lightlevel);
+
+  for (thing = sector->thinglist; thing; thing = thing->snext) {
+    if (thing->flags & MF_SHADOW)
+      return 0;
+
+    sum = R_Sum(sum, thing->x);
+    sum = R_Sum(sum, thing->y);
+    sum = R_Sum(sum, thing->z);
+    sum = R_Sum(sum, thing->angle);
+    sum = R_Sum(sum, thing->sprite);
+    sum = R_Sum(sum, thing->frame);
+    sum = R_Sum(sum, thing->flags & MF_TRANSLATION);
+  }
+
+  return sum ? sum : 1;
+}
+
+static unsigned int R_SideSum(side_t *side) {
+  unsigned int sum;
+
+  sum = 2166136261u;
+  sum = R_Sum(sum, texturetranslation[side->toptexture]);
+  sum = R_Sum(sum, texturetranslation[side->midtexture]);
+  sum = R_Sum(sum, texturetranslation[side->bottomtexture]);
+  sum = R_Sum(sum, side->textureoffset);
+  sum = R_Sum(sum, side->rowoffset);
+
+  return sum;
+}
+
+//
+// R_ViewSum
+// Returns 0 for a view that can't be reused.
+//
+static unsigned int R_ViewSum(player_t *player) {
+  unsigned int sum;
+  int i;
+
+  if (player->mo->flags & MF_SHADOW)
+    return 0;
+
+  sum = 2166136261u;
+  sum = R_Sum(sum, (uintptr_t)player);
+  sum = R_Sum(sum, viewx);
+  sum = R_Sum(sum, viewy);
+  sum = R_Sum(sum, viewz);
+  sum = R_Sum(sum, viewangle);
+  sum = R_Sum(sum, extralight);
+  sum = R_Sum(sum, (uintptr_t)fixedcolormap);
+  sum = R_Sum(sum, detailshift);
+  sum = R_Sum(sum, viewwindowx);
+  sum = R_Sum(sum, viewwindowy);
+  sum = R_Sum(sum, scaledviewwidth);
+  sum = R_Sum(sum, viewheight);
+  sum = R_Sum(sum, skytexture);
+
+#ifdef TRUECOLOR
+  // The palette is baked into the pixels, and so is the gamma
+  // level: a gamma change rebuilds the colormaps in place.
+  sum = R_Sum(sum, (uintptr_t)colormaps32);
+  sum = R_Sum(sum, usegamma);
+#endif
+
+  for (i = 0; i < NUMPSPRITES; i++) {
+    sum = R_Sum(sum, (uintptr_t)player->psprites[i].state);
+    sum = R_Sum(sum, player->psprites[i].sx);
+    sum = R_Sum(sum, player->psprites[i].sy);
+  }
+
+  return sum ? sum : 1;
+}
+
+void R_MarkSectorSeen(sector_t *sector) {
+  int i;
+
+  if (!sectorstamps)
+    return;
+
+  i = sector - sectors;
+
+  if (sectorstamps[i] != seenstamp) {
+    sectorstamps[i] = seenstamp;
+    seensectors[numseensectors++] = sector;
+  }
+}
+
+void R_MarkLineSeen(seg_t *line) {
+  int i;
+
+  if (!sidestamps)
+    return;
+
+  i = line->sidedef - sides;
+
+  if (sidestamps[i] != seenstamp) {
+    sidestamps[i] = seenstamp;
+    seensides[numseensides++] = line->sidedef;
+  }
+
+  if (line->backsector)
+    R_MarkSectorSeen(line->backsector);
+}
+
+//
+// R_CopyView
+// Between the view window and savedview.
+//
+static void R_CopyView(boolean save) {
+  int y;
+#ifdef TRUECOLOR
+  uint32_t *dest;
+  uint32_t *line;
+  int width;
+  int pitch;
+
+  // Each view pixel covers fb_scaling x fb_scaling pixels
+  dest = savedview;
+  line = I_ScreenBuffer32(viewwindowx, viewwindowy);
+  width = scaledviewwidth * fb_scaling;
+  pitch = (I_ScreenBuffer32(0, 1) - I_ScreenBuffer32(0, 0)) / fb_scaling;
+
+  for (y = 0; y < viewheight * fb_scaling; y++) {
+    if (save)
+      memcpy(dest, line, width * sizeof(*dest));
+    else
+      memcpy(line, dest, width * sizeof(*dest));
+
+    dest += width;
+    line += pitch;
+  }
+#else
+  byte *dest;
+
+  dest = savedview;
+
+  for (y = viewwindowy; y < viewwindowy + viewheight; y++) {
+    byte *line = I_VideoBuffer + y * SCREENWIDTH + viewwindowx;
+
+    if (save)
+      memcpy(dest, line, scaledviewwidth);
+    else
+      memcpy(line, dest, scaledviewwidth);
+
+    dest += scaledviewwidth;
+  }
+#endif
+}
+
+boolean R_ViewUnchanged(player_t *player) {
+  static int noviewreuse = -1;
+  int i;
+
+  //!
+  // @category obscure
+  //
+  // Draw the view every frame, even when nothing in it changed,
+  // e.g. to measure what reusing the view saves.
+  //
+
+  if (noviewreuse < 0)
+    noviewreuse = M_ParmExists("-noviewreuse");
+
+  // Without the lists, nothing is recorded or kept either.
+  if (noviewreuse)
+    return false;
+
+  // A new level since the lists were made?
+  if (!seensectors) {
+    viewkept = false;
+    keepingpays = true;
+    keptchangedview = false;
+    lastframesum = 0;
+
+    seensectors = Z_Malloc(numsectors * sizeof(*seensectors), PU_LEVEL,
+                           &seensectors);
+    sectorsums =
+        Z_Malloc(numsectors * sizeof(*sectorsums), PU_LEVEL, &sectorsums);
+    sectorstamps =
+        Z_Malloc(numsectors * sizeof(*sectorstamps), PU_LEVEL, &sectorstamps);
+    seensides =
+        Z_Malloc(numsides * sizeof(*seensides), PU_LEVEL, &seensides);
+    sidesums = Z_Malloc(numsides * sizeof(*sidesums), PU_LEVEL, &sidesums);
+    sidestamps =
+        Z_Malloc(numsides * sizeof(*sidestamps), PU_LEVEL, &sidestamps);
+
+    memset(sectorstamps, 0, numsectors * sizeof(*sectorstamps));
+    memset(sidestamps, 0, numsides * sizeof(*sidestamps));
+  }
+
+  if (viewkept && R_ViewSum(player) == viewsum) {
+    for (i = 0; i < numseensectors; i++) {
+      if (R_SectorSum(seensectors[i]) != sectorsums[i])
+        break;
+    }
+
+    if (i == numseensectors) {
+      for (i = 0; i < numseensides; i++) {
+        if (R_SideSum(seensides[i]) != sidesums[i])
+          break;
+      }
+
+      if (i == numseensides) {
+        R_CopyView(false);
+        keepingpays = true;
+        keptchangedview = false;
+        return true;
+      }
+    }
+  }
+
+  // Start recording the view about to be drawn.
+  viewkept = false;
+  numseensectors = 0;
+  numseensides = 0;
+  seenstamp++;
+
+  return false;
+}
+
+void R_KeepView(player_t *player) {
+  unsigned int framesum;
+  boolean repeated;
+  int i;
+
+  if (!seensectors)
+    return;
+
+  viewsum = R_ViewSum(player);
+
+  if (!viewsum) {
+    lastframesum = 0;
+    return;
+  }
+
+  framesum = R_Sum(viewsum, numseensectors);
+
+  for (i = 0; i < numseensectors; i++) {
+    sectorsums[i] = R_SectorSum(seensectors[i]);
+
+    if (!sectorsums[i]) {
+      lastframesum = 0;
+      return;
+    }
+
+    framesum = R_Sum(framesum, sectorsums[i]);
+  }
+
+  for (i = 0; i < numseensides; i++) {
+    sidesums[i] = R_SideSum(seensides[i]);
+    framesum = R_Sum(framesum, sidesums[i]);
+  }
+
+  // A view drawn again, unchanged, would have been worth
+  //  saving. A view saved just as it changed, and then not
+  //  put back before the next one was drawn, wasn't.
+  repeated = framesum == lastframesum;
+  lastframesum = framesum;
+
+  if (repeated)
+    keepingpays = true;
+  else if (keptchangedview)
+    keepingpays = false;
+
+  keptchangedview = false;
+
+  if (!keepingpays)
+    return;
+
+  R_CopyView(true);
+  viewkept = true;
+  keptchangedview = !repeated;
+}
@@ -22,6 +22,7 @@
 #include "deh_main.h"
 #include "i_swap.h"
 #include "i_system.h"
+#include "i_video.h"
 #include "z_zone.h"
 
 #include "w_wad.h"
@@ -33,6 +34,7 @@
 
 #include "doomstat.h"
 #include "r_sky.h"
+#include "r_slice.h"
 
 #include "r_data.h"
 
@@ -137,6 +139,13 @@ short **texturecolumnlump;
 unsigned short **texturecolumnofs;
 byte **texturecomposite;
 
+// All the composite textures used by the current level, built by
+//  R_PrecacheLevel and freed along with the rest of the level.
+//  textureatlasofs is where each texture's composite begins in it,
+//  or -1 for textures left to R_GenerateComposite.
+static byte *textureatlas;
+static int *textureatlasofs;
+
 // for global animation
 int *flattranslation;
 int *texturetranslation;
@@ -148,6 +157,19 @@ fixed_t *spritetopoffset;
 
 lighttable_t *colormaps;
 
+#ifdef TRUECOLOR
+uint32_t *colormaps32;
+
+// A full set of 32-bit colormaps for every palette in PLAYPAL, so that
+// switching palette (e.g. for a damage or bonus flash) is only a matter of
+// moving colormaps32. They depend on the gamma level, so are rebuilt when
+// that changes.
+static uint32_t *truecolormaps;
+static int numcolormaps;
+static int numpalettes;
+static int truecolorgamma;
+#endif
+
 //
 // MAPTEXTURE_T CACHING
 // When a texture is first needed,
@@ -192,13 +214,11 @@ void R_DrawColumnInCache(column_t *patch, byte *cache, int originy,
 }
 
 //
-// R_GenerateComposite
-// Using the texture definition,
-//  the composite texture is created from the patches,
-//  and each column is cached.
+// R_ComposeTexture
+// Draws the columns of a texture that are made
+//  of more than one patch into block.
 //
-void R_GenerateComposite(int texnum) {
-  byte *block;
+static void R_ComposeTexture(int texnum, byte *block) {
   texture_t *texture;
   texpatch_t *patch;
   patch_t *realpatch;
@@ -212,9 +232,6 @@ void R_GenerateComposite(int texnum) {
 
   texture = textures[texnum];
 
-  block = Z_Malloc(texturecompositesize[texnum], PU_STATIC,
-                   &texturecomposite[texnum]);
-
   collump = texturecolumnlump[texnum];
   colofs = texturecolumnofs[texnum];
 
@@ -245,6 +262,21 @@ void R_GenerateComposite(int texnum) {
                           texture->height);
     }
   }
+}
+
+//
+// R_GenerateComposite
+// Using the texture definition,
+//  the composite texture is created from the patches,
+//  and each column is cached.
+//
+void R_GenerateComposite(int texnum) {
+  byte *block;
+
+  block = Z_Malloc(texturecompositesize[texnum], PU_STATIC,
+                   &texturecomposite[texnum]);
+
+  R_ComposeTexture(texnum, block);
 
   // Now that the texture has been built in column cache,
   //  it is purgable from zone memory.
@@ -339,6 +371,9 @@ byte *R_GetColumn(int tex, int col) {
   if (lump > 0)
     return (byte *)W_CacheLumpNum(lump, PU_CACHE) + ofs;
 
+  if (textureatlas && textureatlasofs[tex] >= 0)
+    return textureatlas + textureatlasofs[tex] + ofs;
+
   if (!texturecomposite[tex])
     R_GenerateComposite(tex);
 
@@ -462,6 +497,8 @@ void R_InitTextures(void) {
       Z_Malloc(numtextures * sizeof(*texturecomposite), PU_STATIC, 0);
   texturecompositesize =
       Z_Malloc(numtextures * sizeof(*texturecompositesize), PU_STATIC, 0);
+  textureatlasofs =
+      Z_Malloc(numtextures * sizeof(*textureatlasofs), PU_STATIC, 0);
   texturewidthmask =
       Z_Malloc(numtextures * sizeof(*texturewidthmask), PU_STATIC, 0);
   textureheight = Z_Malloc(numtextures * sizeof(*textureheight), PU_STATIC, 0);
@@ -609,6 +646,58 @@ void R_InitSpriteLumps(void) {
   }
 }
 
+#ifdef TRUECOLOR
+//
+// R_InitTruecolorMaps
+// Expands every colormap through every palette,
+//  at the current gamma level.
+//
+static void R_InitTruecolorMaps(void) {
+  byte *playpal;
+  byte *color;
+  uint32_t *dest;
+  int p;
+  int i;
+
+  playpal = W_CacheLumpName(DEH_String("PLAYPAL"), PU_STATIC);
+  dest = truecolormaps;
+
+  for (p = 0; p < numpalettes; p++) {
+    for (i = 0; i < numcolormaps * 256; i++) {
+      color = playpal + p * 768 + colormaps[i] * 3;
+      *dest++ = (gammatable[usegamma][color[0]] << 16) |
+                (gammatable[usegamma][color[1]] << 8) |
+                gammatable[usegamma][color[2]];
+    }
+  }
+
+  truecolorgamma = usegamma;
+}
+
+//
+// R_SetTruecolorPalette
+// Called along with I_SetPalette.
+//
+void R_SetTruecolorPalette(byte *palette) {
+  byte *playpal;
+  int p;
+
+  if (truecolormaps == NULL)
+    return;
+
+  if (truecolorgamma != usegamma)
+    R_InitTruecolorMaps();
+
+  playpal = W_CacheLumpName(DEH_String("PLAYPAL"), PU_STATIC);
+  p = (palette - playpal) / 768;
+
+  if (palette < playpal || p >= numpalettes)
+    p = 0;
+
+  colormaps32 = truecolormaps + p * numcolormaps * 256;
+}
+#endif
+
 //
 // R_InitColormaps
 //
@@ -619,6 +708,16 @@ void R_InitColormaps(void) {
   //  256 byte align tables.
   lump = W_GetNumForName(DEH_String("COLORMAP"));
   colormaps = W_CacheLumpNum(lump, PU_STATIC);
+
+#ifdef TRUECOLOR
+  numcolormaps = W_LumpLength(lump) / 256;
+  numpalettes = W_LumpLength(W_GetNumForName(DEH_String("PLAYPAL"))) / 768;
+  truecolormaps =
+      Z_Malloc(numpalettes * numcolormaps * 256 * sizeof(*truecolormaps),
+               PU_STATIC, NULL);
+  R_InitTruecolorMaps();
+  colormaps32 = truecolormaps;
+#endif
 }
 
 //
@@ -698,6 +797,119 @@ int R_TextureNumForName(char *name) {
   return i;
 }
 
+//
+// R_MarkTexturesPresent
+// Finds every texture the level can show,
+//  including the other frames of animated
+//  textures and the other side of switches.
+//
+static void R_MarkTexturesPresent(char *texturepresent) {
+  int i;
+
+  memset(texturepresent, 0, numtextures);
+
+  for (i = 0; i < numsides; i++) {
+    texturepresent[sides[i].toptexture] = 1;
+    texturepresent[sides[i].midtexture] = 1;
+    texturepresent[sides[i].bottomtexture] = 1;
+  }
+
+  // Sky texture is always present.
+  // Note that F_SKY1 is the name used to
+  //  indicate a sky floor/ceiling as a flat,
+  //  while the sky texture is stored like
+  //  a wall texture, with an episode dependend
+  //  name.
+  texturepresent[skytexture] = 1;
+
+  P_MarkAnimatedTextures(texturepresent);
+  P_MarkSwitchTextures(texturepresent);
+}
+
+//
+// R_LayOutTextureAtlas
+// Gives each texture in the level a place in the atlas,
+//  in order, until the next would go past the budget.
+// Returns the size of the atlas.
+//
+static int R_LayOutTextureAtlas(char *texturepresent, int budget) {
+  int i;
+  int size;
+
+  size = 0;
+
+  for (i = 0; i < numtextures; i++) {
+    textureatlasofs[i] = -1;
+
+    if (!texturepresent[i] || !texturecompositesize[i] ||
+        size + texturecompositesize[i] > budget)
+      continue;
+
+    textureatlasofs[i] = size;
+    size += texturecompositesize[i];
+  }
+
+  return size;
+}
+
+//
+// R_InitTextureAtlas
+// Composites every multi-patch texture in the
+//  level into one block up front, so none has to
+//  be built, or rebuilt after being purged, while
+//  the level is being played.
+// The atlas takes at most a quarter of the zone,
+//  and half of what's free once the level is
+//  loaded. If no block that big can be found, it
+//  shrinks until one can. Whatever doesn't fit is
+//  left to R_GetColumn.
+//
+#define MINATLASBUDGET 65536
+
+static void R_InitTextureAtlas(char *texturepresent) {
+  int i;
+  int size;
+  int budget;
+
+  if (textureatlas)
+    Z_Free(textureatlas);
+
+  budget = Z_ZoneSize() / 4;
+
+  if (budget > Z_FreeMemory() / 2)
+    budget = Z_FreeMemory() / 2;
+
+  for (;;) {
+    size = R_LayOutTextureAtlas(texturepresent, budget);
+
+    if (!size)
+      return;
+
+    textureatlas = Z_TryMalloc(size, PU_LEVEL, &textureatlas);
+
+    if (textureatlas)
+      break;
+
+    if (size / 2 < MINATLASBUDGET) {
+      memset(textureatlasofs, -1, numtextures * sizeof(*textureatlasofs));
+      return;
+    }
+
+    budget = size / 2;
+  }
+
+  for (i = 0; i < numtextures; i++) {
+    if (textureatlasofs[i] < 0)
+      continue;
+
+    // Any copy built lazily so far is no longer needed.
+    if (texturecomposite[i])
+      Z_Free(texturecomposite[i]);
+
+    R_ComposeTexture(i, textureatlas + textureatlasofs[i]);
+  }
+}
+
 //
 // R_PrecacheLevel
 // Preloads all relevant graphics for the level.
@@ -720,8 +932,16 @@ void R_PrecacheLevel(void) {
   thinker_t *th;
   spriteframe_t *sf;
 
-  if (demoplayback)
+  // Build the composite textures even for demos,
+  //  so their frame times are as steady.
+  texturepresent = Z_Malloc(numtextures, PU_STATIC, NULL);
+  R_MarkTexturesPresent(texturepresent);
+  R_InitTextureAtlas(texturepresent);
+
+  if (demoplayback) {
+    Z_Free(texturepresent);
     return;
+  }
 
   // Precache flats.
   flatpresent = Z_Malloc(numflats, PU_STATIC, NULL);
@@ -745,23 +965,6 @@ void R_PrecacheLevel(void) {
   Z_Free(flatpresent);
 
   // Precache textures.
-  texturepresent = Z_Malloc(numtextures, PU_STATIC, NULL);
-  memset(texturepresent, 0, numtextures);
-
-  for (i = 0; i < numsides; i++) {
-    texturepresent[sides[i].toptexture] = 1;
-    texturepresent[sides[i].midtexture] = 1;
-    texturepresent[sides[i].bottomtexture] = 1;
-  }
-
-  // Sky texture is always present.
-  // Note that F_SKY1 is the name used to
-  //  indicate a sky floor/ceiling as a flat,
-  //  while the sky texture is stored like
-  //  a wall texture, with an episode dependend
-  //  name.
-  texturepresent[skytexture] = 1;
-
   texturememory = 0;
   for (i = 0; i < numtextures; i++) {
     if (!texturepresent[i])
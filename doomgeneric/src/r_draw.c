@@ -33,6 +33,10 @@
 // State.
 #include "doomstat.h"
 
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
 // ?
 #define MAXWIDTH 1120
 #define MAXHEIGHT 832
@@ -73,18 +77,18 @@ static byte *background_buffer = NULL;
 // R_DrawColumn
 // Source is the top of the column to scale.
 //
-lighttable_t *dc_colormap;
-int dc_x;
-int dc_yl;
-int dc_yh;
-fixed_t dc_iscale;
-fixed_t dc_texturemid;
+DRAW_THREAD_LOCAL lighttable_t *dc_colormap;
+DRAW_THREAD_LOCAL int dc_x;
+DRAW_THREAD_LOCAL int dc_yl;
+DRAW_THREAD_LOCAL int dc_yh;
+DRAW_THREAD_LOCAL fixed_t dc_iscale;
+DRAW_THREAD_LOCAL fixed_t dc_texturemid;
 
 // first pixel in a column (possibly virtual)
-byte *dc_source;
+DRAW_THREAD_LOCAL byte *dc_source;
 
 // just for profiling
-int dccount;
+DRAW_THREAD_LOCAL int dccount;
 
 //
 // A column is a vertical slice/span from a wall texture that,
@@ -134,6 +138,80 @@ void R_DrawColumn(void) {
   } while (count--);
 }
 
+#ifdef __wasm_simd128__
+//
+// R_DrawColumnSIMD
+// Same mapping as R_DrawColumn, but the texture
+//  coordinates of four rows are stepped at once
+//  in a 128-bit vector.
+// The destination rows are SCREENWIDTH apart and
+//  the source and colormap tables are far larger
+//  than one vector, so the two lookups stay scalar.
+//
+void R_DrawColumnSIMD(void) {
+  int count;
+  byte *dest;
+  byte *source;
+  lighttable_t *colormap;
+  unsigned int frac;
+  unsigned int fracstep;
+  v128_t fracs;
+  v128_t fracstep4;
+  v128_t index;
+  v128_t mask;
+
+  count = dc_yh - dc_yl + 1;
+
+  // Zero length, column does not exceed a pixel.
+  if (count <= 0)
+    return;
+
+#ifdef RANGECHECK
+  if ((unsigned)dc_x >= SCREENWIDTH || dc_yl < 0 || dc_yh >= SCREENHEIGHT)
+    I_Error("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+  source = dc_source;
+  colormap = dc_colormap;
+  dest = ylookup[dc_yl] + columnofs[dc_x];
+
+  // Unsigned math wraps exactly like the fixed_t math
+  //  of the scalar loop does on overflow.
+  fracstep = dc_iscale;
+  frac = dc_texturemid + (dc_yl - centery) * fracstep;
+
+  fracs = wasm_i32x4_make(frac, frac + fracstep, frac + fracstep * 2,
+                          frac + fracstep * 3);
+  fracstep4 = wasm_i32x4_splat(fracstep * 4);
+  mask = wasm_i32x4_splat(127);
+
+  while (count >= 4) {
+    // Arithmetic shift, as with the signed fixed_t in R_DrawColumn.
+    index = wasm_v128_and(wasm_i32x4_shr(fracs, FRACBITS), mask);
+
+    dest[0] = colormap[source[wasm_i32x4_extract_lane(index, 0)]];
+    dest[SCREENWIDTH] = colormap[source[wasm_i32x4_extract_lane(index, 1)]];
+    dest[SCREENWIDTH * 2] =
+        colormap[source[wasm_i32x4_extract_lane(index, 2)]];
+    dest[SCREENWIDTH * 3] =
+        colormap[source[wasm_i32x4_extract_lane(index, 3)]];
+
+    fracs = wasm_i32x4_add(fracs, fracstep4);
+    dest += SCREENWIDTH * 4;
+    count -= 4;
+  }
+
+  frac = wasm_i32x4_extract_lane(fracs, 0);
+
+  while (count > 0) {
+    *dest = colormap[source[((fixed_t)frac >> FRACBITS) & 127]];
+    dest += SCREENWIDTH;
+    frac += fracstep;
+    count--;
+  }
+}
+#endif
+
 // UNUSED.
 // Loop unrolled.
 #if 0
@@ -248,7 +326,7 @@ int fuzzoffset[FUZZTABLE] = {
     FUZZOFF,  FUZZOFF,  FUZZOFF,  -FUZZOFF, FUZZOFF,  FUZZOFF,  -FUZZOFF,
     FUZZOFF};
 
-int fuzzpos = 0;
+DRAW_THREAD_LOCAL int fuzzpos = 0;
 
 //
 // Framebuffer postprocessing.
@@ -382,7 +460,7 @@ void R_DrawFuzzColumnLow(void) {
 //  of the BaronOfHell, the HellKnight, uses
 //  identical sprites, kinda brightened up.
 //
-byte *dc_translation;
+DRAW_THREAD_LOCAL byte *dc_translation;
 byte *translationtables;
 
 void R_DrawTranslatedColumn(void) {
@@ -506,22 +584,22 @@ void R_InitTranslationTables(void) {
 // In consequence, flats are not stored by column (like walls),
 //  and the inner loop has to step in texture space u and v.
 //
-int ds_y;
-int ds_x1;
-int ds_x2;
+DRAW_THREAD_LOCAL int ds_y;
+DRAW_THREAD_LOCAL int ds_x1;
+DRAW_THREAD_LOCAL int ds_x2;
 
-lighttable_t *ds_colormap;
+DRAW_THREAD_LOCAL lighttable_t *ds_colormap;
 
-fixed_t ds_xfrac;
-fixed_t ds_yfrac;
-fixed_t ds_xstep;
-fixed_t ds_ystep;
+DRAW_THREAD_LOCAL fixed_t ds_xfrac;
+DRAW_THREAD_LOCAL fixed_t ds_yfrac;
+DRAW_THREAD_LOCAL fixed_t ds_xstep;
+DRAW_THREAD_LOCAL fixed_t ds_ystep;
 
 // start of a 64*64 tile image
-byte *ds_source;
+DRAW_THREAD_LOCAL byte *ds_source;
 
 // just for profiling
-int dscount;
+DRAW_THREAD_LOCAL int dscount;
 
 //
 // Draws the actual span.
@@ -568,6 +646,186 @@ void R_DrawSpan(void) {
   } while (count--);
 }
 
+#ifdef __wasm_simd128__
+//
+// R_DrawSpanSIMD
+// Same mapping as R_DrawSpan, but sixteen packed
+//  texture positions are stepped at once, and
+//  sixteen finished pixels are written with a
+//  single vector store.
+// A flat is 4096 bytes, too big to gather from
+//  with vector shuffles, so the two lookups per
+//  pixel stay scalar.
+//
+#define SPANLOOKUP(v, lane)                                                    \
+  colormap[source[wasm_i32x4_extract_lane(v, lane)]]
+
+void R_DrawSpanSIMD(void) {
+  unsigned int position, step;
+  byte *dest;
+  byte *source;
+  lighttable_t *colormap;
+  int count;
+  v128_t pos0, pos1, pos2, pos3;
+  v128_t spot0, spot1, spot2, spot3;
+  v128_t step16;
+  v128_t ymask;
+
+#ifdef RANGECHECK
+  if (ds_x2 < ds_x1 || ds_x1 < 0 || ds_x2 >= SCREENWIDTH ||
+      (unsigned)ds_y > SCREENHEIGHT) {
+    I_Error("R_DrawSpan: %i to %i at %i", ds_x1, ds_x2, ds_y);
+  }
+#endif
+
+  // Same packing as R_DrawSpan: x in the top 16 bits,
+  //  y in the bottom 16 bits, 6.10 fixed point each.
+  position = ((ds_xfrac << 10) & 0xffff0000) | ((ds_yfrac >> 6) & 0x0000ffff);
+  step = ((ds_xstep << 10) & 0xffff0000) | ((ds_ystep >> 6) & 0x0000ffff);
+
+  source = ds_source;
+  colormap = ds_colormap;
+  dest = ylookup[ds_y] + columnofs[ds_x1];
+
+  count = ds_x2 - ds_x1 + 1;
+
+  // Pixel n of the next sixteen lives in lane n&3 of posN>>2.
+  pos0 = wasm_i32x4_make(position, position + step, position + step * 2,
+                         position + step * 3);
+  pos1 = wasm_i32x4_add(pos0, wasm_i32x4_splat(step * 4));
+  pos2 = wasm_i32x4_add(pos0, wasm_i32x4_splat(step * 8));
+  pos3 = wasm_i32x4_add(pos0, wasm_i32x4_splat(step * 12));
+  step16 = wasm_i32x4_splat(step * 16);
+  ymask = wasm_i32x4_splat(0x0fc0);
+
+  while (count >= 16) {
+    spot0 = wasm_v128_or(wasm_v128_and(wasm_u32x4_shr(pos0, 4), ymask),
+                         wasm_u32x4_shr(pos0, 26));
+    spot1 = wasm_v128_or(wasm_v128_and(wasm_u32x4_shr(pos1, 4), ymask),
+                         wasm_u32x4_shr(pos1, 26));
+    spot2 = wasm_v128_or(wasm_v128_and(wasm_u32x4_shr(pos2, 4), ymask),
+                         wasm_u32x4_shr(pos2, 26));
+    spot3 = wasm_v128_or(wasm_v128_and(wasm_u32x4_shr(pos3, 4), ymask),
+                         wasm_u32x4_shr(pos3, 26));
+
+    wasm_v128_store(
+        dest, wasm_u8x16_make(
+                  SPANLOOKUP(spot0, 0), SPANLOOKUP(spot0, 1),
+                  SPANLOOKUP(spot0, 2), SPANLOOKUP(spot0, 3),
+                  SPANLOOKUP(spot1, 0), SPANLOOKUP(spot1, 1),
+                  SPANLOOKUP(spot1, 2), SPANLOOKUP(spot1, 3),
+                  SPANLOOKUP(spot2, 0), SPANLOOKUP(spot2, 1),
+                  SPANLOOKUP(spot2, 2), SPANLOOKUP(spot2, 3),
+                  SPANLOOKUP(spot3, 0), SPANLOOKUP(spot3, 1),
+                  SPANLOOKUP(spot3, 2), SPANLOOKUP(spot3, 3)));
+
+    pos0 = wasm_i32x4_add(pos0, step16);
+    pos1 = wasm_i32x4_add(pos1, step16);
+    pos2 = wasm_i32x4_add(pos2, step16);
+    pos3 = wasm_i32x4_add(pos3, step16);
+    dest += 16;
+    count -= 16;
+  }
+
+  position = wasm_i32x4_extract_lane(pos0, 0);
+
+  while (count > 0) {
+    *dest++ = colormap[source[((position >> 4) & 0x0fc0) | (position >> 26)]];
+    position += step;
+    count--;
+  }
+}
+
+#undef SPANLOOKUP
+
+#ifdef SIMD_CHECK
+// I_Error never returns in this build, so differences are
+//  reported and drawing carries on, up to a point.
+#define MAXSIMDREPORTS 10
+
+static int simdreports;
+
+//
+// R_DrawColumnSIMDChecked
+// Draws the column through both R_DrawColumn and
+//  R_DrawColumnSIMD, and reports it if they differ.
+//
+void R_DrawColumnSIMDChecked(void) {
+  byte before[SCREENHEIGHT];
+  byte expected[SCREENHEIGHT];
+  byte *dest;
+  int count;
+  int i;
+
+  count = dc_yh - dc_yl + 1;
+
+  if (count <= 0)
+    return;
+
+  dest = ylookup[dc_yl] + columnofs[dc_x];
+
+  for (i = 0; i < count; i++)
+    before[i] = dest[i * SCREENWIDTH];
+
+  R_DrawColumn();
+
+  for (i = 0; i < count; i++) {
+    expected[i] = dest[i * SCREENWIDTH];
+    dest[i * SCREENWIDTH] = before[i];
+  }
+
+  R_DrawColumnSIMD();
+
+  for (i = 0; i < count; i++) {
+    if (dest[i * SCREENWIDTH] != expected[i]) {
+      if (simdreports++ < MAXSIMDREPORTS) {
+        fprintf(stderr,
+                "R_DrawColumnSIMD: row %i differs from R_DrawColumn "
+                "(dc_x %i, dc_yl %i, dc_yh %i, dc_iscale %i, "
+                "dc_texturemid %i, centery %i)\n",
+                dc_yl + i, dc_x, dc_yl, dc_yh, dc_iscale, dc_texturemid,
+                centery);
+      }
+      return;
+    }
+  }
+}
+
+//
+// R_DrawSpanSIMDChecked
+// Draws the span through both R_DrawSpan and
+//  R_DrawSpanSIMD, and reports it if they differ.
+//
+void R_DrawSpanSIMDChecked(void) {
+  byte before[SCREENWIDTH];
+  byte expected[SCREENWIDTH];
+  byte *dest;
+  int count;
+
+  count = ds_x2 - ds_x1 + 1;
+
+  if (count <= 0)
+    return;
+
+  dest = ylookup[ds_y] + columnofs[ds_x1];
+
+  memcpy(before, dest, count);
+  R_DrawSpan();
+  memcpy(expected, dest, count);
+  memcpy(dest, before, count);
+  R_DrawSpanSIMD();
+
+  if (memcmp(dest, expected, count) != 0 &&
+      simdreports++ < MAXSIMDREPORTS) {
+    fprintf(stderr,
+            "R_DrawSpanSIMD: differs from R_DrawSpan (ds_y %i, ds_x1 %i, "
+            "ds_x2 %i, ds_xfrac %i, ds_yfrac %i, ds_xstep %i, ds_ystep %i)\n",
+            ds_y, ds_x1, ds_x2, ds_xfrac, ds_yfrac, ds_xstep, ds_ystep);
+  }
+}
+#endif
+#endif
+
 // UNUSED.
 // Loop unrolled by 4.
 #if 0
@@ -685,6 +943,309 @@ void R_DrawSpanLow(void) {
   } while (count--);
 }
 
+#ifdef TRUECOLOR
+//
+// 32-bit drawers.
+// Same as the ones above, except that they write
+//  the colormaps32 color for each pixel straight into
+//  DG_ScreenBuffer, where each pixel of the view covers
+//  fb_scaling x fb_scaling pixels.
+//
+static uint32_t *ylookup32[MAXHEIGHT];
+static int columnofs32[MAXWIDTH];
+static int fuzzoffset32[FUZZTABLE];
+
+// DG_ScreenBuffer pixels per line of DG_ScreenBuffer,
+//  and per line of the view.
+static int fbpitch32;
+static int viewpitch32;
+
+// The colormaps32 entries for an 8-bit lighttable.
+#define COLORMAP32(cmap) (colormaps32 + ((cmap)-colormaps))
+
+static inline void R_PutPixel32(uint32_t *dest, int width, uint32_t color) {
+  int x;
+  int y;
+
+  width *= fb_scaling;
+
+  for (y = 0; y < fb_scaling; y++) {
+    for (x = 0; x < width; x++)
+      dest[x] = color;
+    dest += fbpitch32;
+  }
+}
+
+// Close to colormap #6 (13/16 brightness), which
+//  can't be used on a pixel that is no longer an index.
+static inline uint32_t R_Fuzz32(uint32_t pix) {
+  return pix - ((pix >> 2) & 0x3f3f3f) + ((pix >> 4) & 0x0f0f0f);
+}
+
+void R_DrawColumn32(void) {
+  int count;
+  uint32_t *dest;
+  uint32_t *colormap;
+  fixed_t frac;
+  fixed_t fracstep;
+
+  count = dc_yh - dc_yl;
+
+  if (count < 0)
+    return;
+
+#ifdef RANGECHECK
+  if ((unsigned)dc_x >= SCREENWIDTH || dc_yl < 0 || dc_yh >= SCREENHEIGHT)
+    I_Error("R_DrawColumn32: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+  dest = ylookup32[dc_yl] + columnofs32[dc_x];
+  colormap = COLORMAP32(dc_colormap);
+
+  fracstep = dc_iscale;
+  frac = dc_texturemid + (dc_yl - centery) * fracstep;
+
+  do {
+    R_PutPixel32(dest, 1, colormap[dc_source[(frac >> FRACBITS) & 127]]);
+    dest += viewpitch32;
+    frac += fracstep;
+  } while (count--);
+}
+
+void R_DrawColumnLow32(void) {
+  int count;
+  uint32_t *dest;
+  uint32_t *colormap;
+  fixed_t frac;
+  fixed_t fracstep;
+
+  count = dc_yh - dc_yl;
+
+  if (count < 0)
+    return;
+
+#ifdef RANGECHECK
+  if ((unsigned)dc_x >= SCREENWIDTH || dc_yl < 0 || dc_yh >= SCREENHEIGHT)
+    I_Error("R_DrawColumnLow32: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+  // Blocky mode, need to multiply by 2.
+  dest = ylookup32[dc_yl] + columnofs32[dc_x << 1];
+  colormap = COLORMAP32(dc_colormap);
+
+  fracstep = dc_iscale;
+  frac = dc_texturemid + (dc_yl - centery) * fracstep;
+
+  do {
+    R_PutPixel32(dest, 2, colormap[dc_source[(frac >> FRACBITS) & 127]]);
+    dest += viewpitch32;
+    frac += fracstep;
+  } while (count--);
+}
+
+void R_DrawFuzzColumn32(void) {
+  int count;
+  uint32_t *dest;
+
+  // Adjust borders. Low...
+  if (!dc_yl)
+    dc_yl = 1;
+
+  // .. and high.
+  if (dc_yh == viewheight - 1)
+    dc_yh = viewheight - 2;
+
+  count = dc_yh - dc_yl;
+
+  if (count < 0)
+    return;
+
+#ifdef RANGECHECK
+  if ((unsigned)dc_x >= SCREENWIDTH || dc_yl < 0 || dc_yh >= SCREENHEIGHT)
+    I_Error("R_DrawFuzzColumn32: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+  dest = ylookup32[dc_yl] + columnofs32[dc_x];
+
+  do {
+    R_PutPixel32(dest, 1, R_Fuzz32(dest[fuzzoffset32[fuzzpos]]));
+
+    if (++fuzzpos == FUZZTABLE)
+      fuzzpos = 0;
+
+    dest += viewpitch32;
+  } while (count--);
+}
+
+void R_DrawFuzzColumnLow32(void) {
+  int count;
+  uint32_t *dest;
+  int half;
+
+  // Adjust borders. Low...
+  if (!dc_yl)
+    dc_yl = 1;
+
+  // .. and high.
+  if (dc_yh == viewheight - 1)
+    dc_yh = viewheight - 2;
+
+  count = dc_yh - dc_yl;
+
+  if (count < 0)
+    return;
+
+#ifdef RANGECHECK
+  if ((unsigned)(dc_x << 1) >= SCREENWIDTH || dc_yl < 0 ||
+      dc_yh >= SCREENHEIGHT)
+    I_Error("R_DrawFuzzColumnLow32: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+  dest = ylookup32[dc_yl] + columnofs32[dc_x << 1];
+  half = columnofs32[1] - columnofs32[0];
+
+  do {
+    R_PutPixel32(dest, 1, R_Fuzz32(dest[fuzzoffset32[fuzzpos]]));
+    R_PutPixel32(dest + half, 1, R_Fuzz32(dest[half + fuzzoffset32[fuzzpos]]));
+
+    if (++fuzzpos == FUZZTABLE)
+      fuzzpos = 0;
+
+    dest += viewpitch32;
+  } while (count--);
+}
+
+void R_DrawTranslatedColumn32(void) {
+  int count;
+  uint32_t *dest;
+  uint32_t *colormap;
+  fixed_t frac;
+  fixed_t fracstep;
+
+  count = dc_yh - dc_yl;
+  if (count < 0)
+    return;
+
+#ifdef RANGECHECK
+  if ((unsigned)dc_x >= SCREENWIDTH || dc_yl < 0 || dc_yh >= SCREENHEIGHT)
+    I_Error("R_DrawTranslatedColumn32: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+  dest = ylookup32[dc_yl] + columnofs32[dc_x];
+  colormap = COLORMAP32(dc_colormap);
+
+  fracstep = dc_iscale;
+  frac = dc_texturemid + (dc_yl - centery) * fracstep;
+
+  do {
+    R_PutPixel32(dest, 1,
+                 colormap[dc_translation[dc_source[frac >> FRACBITS]]]);
+    dest += viewpitch32;
+    frac += fracstep;
+  } while (count--);
+}
+
+void R_DrawTranslatedColumnLow32(void) {
+  int count;
+  uint32_t *dest;
+  uint32_t *colormap;
+  fixed_t frac;
+  fixed_t fracstep;
+
+  count = dc_yh - dc_yl;
+  if (count < 0)
+    return;
+
+#ifdef RANGECHECK
+  if ((unsigned)(dc_x << 1) >= SCREENWIDTH || dc_yl < 0 ||
+      dc_yh >= SCREENHEIGHT)
+    I_Error("R_DrawTranslatedColumnLow32: %i to %i at %i", dc_yl, dc_yh,
+            dc_x);
+#endif
+
+  dest = ylookup32[dc_yl] + columnofs32[dc_x << 1];
+  colormap = COLORMAP32(dc_colormap);
+
+  fracstep = dc_iscale;
+  frac = dc_texturemid + (dc_yl - centery) * fracstep;
+
+  do {
+    R_PutPixel32(dest, 2,
+                 colormap[dc_translation[dc_source[frac >> FRACBITS]]]);
+    dest += viewpitch32;
+    frac += fracstep;
+  } while (count--);
+}
+
+void R_DrawSpan32(void) {
+  unsigned int position, step;
+  uint32_t *dest;
+  uint32_t *colormap;
+  int count;
+  int spot;
+  int width;
+
+#ifdef RANGECHECK
+  if (ds_x2 < ds_x1 || ds_x1 < 0 || ds_x2 >= SCREENWIDTH ||
+      (unsigned)ds_y > SCREENHEIGHT) {
+    I_Error("R_DrawSpan32: %i to %i at %i", ds_x1, ds_x2, ds_y);
+  }
+#endif
+
+  // Same packed position as R_DrawSpan
+  position = ((ds_xfrac << 10) & 0xffff0000) | ((ds_yfrac >> 6) & 0x0000ffff);
+  step = ((ds_xstep << 10) & 0xffff0000) | ((ds_ystep >> 6) & 0x0000ffff);
+
+  dest = ylookup32[ds_y] + columnofs32[ds_x1];
+  colormap = COLORMAP32(ds_colormap);
+  width = columnofs32[1] - columnofs32[0];
+
+  count = ds_x2 - ds_x1;
+
+  do {
+    spot = ((position >> 4) & 0x0fc0) | (position >> 26);
+    R_PutPixel32(dest, 1, colormap[ds_source[spot]]);
+    dest += width;
+    position += step;
+  } while (count--);
+}
+
+void R_DrawSpanLow32(void) {
+  unsigned int position, step;
+  uint32_t *dest;
+  uint32_t *colormap;
+  int count;
+  int spot;
+  int width;
+
+#ifdef RANGECHECK
+  if (ds_x2 < ds_x1 || ds_x1 < 0 || ds_x2 >= SCREENWIDTH ||
+      (unsigned)ds_y > SCREENHEIGHT) {
+    I_Error("R_DrawSpanLow32: %i to %i at %i", ds_x1, ds_x2, ds_y);
+  }
+#endif
+
+  position = ((ds_xfrac << 10) & 0xffff0000) | ((ds_yfrac >> 6) & 0x0000ffff);
+  step = ((ds_xstep << 10) & 0xffff0000) | ((ds_ystep >> 6) & 0x0000ffff);
+
+  // Blocky mode, need to multiply by 2.
+  dest = ylookup32[ds_y] + columnofs32[ds_x1 << 1];
+  colormap = COLORMAP32(ds_colormap);
+  width = 2 * (columnofs32[1] - columnofs32[0]);
+
+  count = ds_x2 - ds_x1;
+
+  do {
+    spot = ((position >> 4) & 0x0fc0) | (position >> 26);
+    R_PutPixel32(dest, 2, colormap[ds_source[spot]]);
+    dest += width;
+    position += step;
+  } while (count--);
+}
+
+#undef COLORMAP32
+#endif
+
 //
 // R_InitBuffer
 // Creats lookup tables that avoid
@@ -713,6 +1274,22 @@ void R_InitBuffer(int width, int height) {
   // Preclaculate all row offsets.
   for (i = 0; i < height; i++)
     ylookup[i] = I_VideoBuffer + (i + viewwindowy) * SCREENWIDTH;
+
+#ifdef TRUECOLOR
+  // The same, in DG_ScreenBuffer.
+  for (i = 0; i < width; i++)
+    columnofs32[i] =
+        I_ScreenBuffer32(viewwindowx + i, 0) - I_ScreenBuffer32(0, 0);
+
+  for (i = 0; i < height; i++)
+    ylookup32[i] = I_ScreenBuffer32(0, i + viewwindowy);
+
+  viewpitch32 = I_ScreenBuffer32(0, 1) - I_ScreenBuffer32(0, 0);
+  fbpitch32 = viewpitch32 / fb_scaling;
+
+  for (i = 0; i < FUZZTABLE; i++)
+    fuzzoffset32[i] = fuzzoffset[i] / FUZZOFF * viewpitch32;
+#endif
 }
 
 //
@@ -29,6 +29,8 @@
 
 #include "r_local.h"
 #include "r_sky.h"
+#include "r_slice.h"
+#include "r_coherence.h"
 
 // Fineangles in the SCREENWIDTH wide window.
 #define FIELDOFVIEW 2048
@@ -572,10 +574,22 @@ void R_ExecuteSetViewSize(void) {
   projection = centerxfrac;
 
   if (!detailshift) {
+#if defined(__wasm_simd128__) && defined(SIMD_CHECK)
+    colfunc = basecolfunc = R_DrawColumnSIMDChecked;
+#elif defined(__wasm_simd128__)
+    colfunc = basecolfunc = R_DrawColumnSIMD;
+#else
     colfunc = basecolfunc = R_DrawColumn;
+#endif
     fuzzcolfunc = R_DrawFuzzColumn;
     transcolfunc = R_DrawTranslatedColumn;
+#if defined(__wasm_simd128__) && defined(SIMD_CHECK)
+    spanfunc = R_DrawSpanSIMDChecked;
+#elif defined(__wasm_simd128__)
+    spanfunc = R_DrawSpanSIMD;
+#else
     spanfunc = R_DrawSpan;
+#endif
   } else {
     colfunc = basecolfunc = R_DrawColumnLow;
     fuzzcolfunc = R_DrawFuzzColumnLow;
@@ -583,6 +597,25 @@ void R_ExecuteSetViewSize(void) {
     spanfunc = R_DrawSpanLow;
   }
 
+#ifdef TRUECOLOR
+  // Draw straight into DG_ScreenBuffer instead.
+  if (!detailshift) {
+    colfunc = basecolfunc = R_DrawColumn32;
+    fuzzcolfunc = R_DrawFuzzColumn32;
+    transcolfunc = R_DrawTranslatedColumn32;
+    spanfunc = R_DrawSpan32;
+  } else {
+    colfunc = basecolfunc = R_DrawColumnLow32;
+    fuzzcolfunc = R_DrawFuzzColumnLow32;
+    transcolfunc = R_DrawTranslatedColumnLow32;
+    spanfunc = R_DrawSpanLow32;
+  }
+#endif
+
+#ifdef RENDER_THREADS
+  R_QueueDrawFuncs();
+#endif
+
   R_InitBuffer(scaledviewwidth, viewheight);
 
   R_InitTextureMapping();
@@ -646,6 +679,9 @@ void R_Init(void) {
   R_InitSkyMap();
   R_InitTranslationTables();
   printf(".");
+#ifdef RENDER_THREADS
+  R_InitSlices();
+#endif
 
   framecount = 0;
 }
@@ -713,6 +749,17 @@ void R_SetupFrame(player_t *player) {
 void R_RenderPlayerView(player_t *player) {
   R_SetupFrame(player);
 
+#ifdef TRUECOLOR
+  I_MarkTruecolorRect(viewwindowx, viewwindowy, scaledviewwidth, viewheight);
+#endif
+
+  // Nothing to do if the view would come out the same.
+  if (R_ViewUnchanged(player)) {
+    // Check for new console commands.
+    NetUpdate();
+    return;
+  }
+
   // Clear buffers.
   R_ClearClipSegs();
   R_ClearDrawSegs();
@@ -735,6 +782,12 @@ void R_RenderPlayerView(player_t *player) {
 
   R_DrawMasked();
 
+#ifdef RENDER_THREADS
+  R_FlushSlices();
+#endif
+
+  R_KeepView(player);
+
   // Check for new console commands.
   NetUpdate();
 }
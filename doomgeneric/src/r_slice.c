@@ -0,0 +1,358 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Threaded drawing of the view in vertical screen slices.
+//	BSP traversal, clipping and sprite sorting still run once,
+//	 on the main thread, but every column and span they produce
+//	 is queued instead of drawn. At the end of the frame the
+//	 view is cut into RENDER_THREADS vertical slices and each
+//	 thread replays, in order, the part of the queue that
+//	 falls inside its slice.
+//	The queue is also drawn early when it fills, and before
+//	 Z_Malloc purges a block, as queued draws point into
+//	 PU_CACHE patches, flats and composites.
+//	Every pixel is written by exactly one thread, in the same
+//	 order as the single threaded renderer, so the result is
+//	 identical.
+//
+
+#ifdef RENDER_THREADS
+
+#include <pthread.h>
+
+#include "doomdef.h"
+
+#include "i_system.h"
+#include "z_zone.h"
+
+#include "r_local.h"
+#include "r_slice.h"
+
+//
+// One queued call to a column or span drawer,
+//  along with all the dc_* / ds_* state it reads.
+//
+typedef struct {
+  void (*drawfunc)(void);
+  boolean span;
+
+  lighttable_t *colormap;
+  byte *source;
+  byte *translation;
+
+  // Column: x1 == x2 == dc_x, y1..y2 == dc_yl..dc_yh.
+  // Span: x1..x2 == ds_x1..ds_x2, y1 == ds_y.
+  int x1;
+  int x2;
+  int y1;
+  int y2;
+
+  // Column: dc_texturemid and dc_iscale.
+  // Span: ds_xfrac, ds_yfrac, ds_xstep, ds_ystep.
+  fixed_t frac;
+  fixed_t yfrac;
+  fixed_t step;
+  fixed_t ystep;
+
+  int fuzzpos;
+} drawcmd_t;
+
+// The queue is allocated once, as a Z_Malloc during the frame
+//  could purge what queued draws read from (see Z_Malloc).
+//  A frame that fills it is drawn in several flushes.
+#define MAXDRAWCMDS 8192
+
+static drawcmd_t *drawcmds;
+static int numdrawcmds;
+
+// The real drawers, as chosen by R_ExecuteSetViewSize.
+static void (*realcolfunc)(void);
+static void (*realfuzzcolfunc)(void);
+static void (*realtranscolfunc)(void);
+static void (*realspanfunc)(void);
+
+// fuzzpos as the main thread would have left it,
+//  had it drawn every fuzz column itself.
+static int queuedfuzzpos;
+
+static pthread_t slicethreads[RENDER_THREADS - 1];
+static pthread_mutex_t slicemutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t slicestart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t slicedone = PTHREAD_COND_INITIALIZER;
+static int sliceframe;
+static int slicesdone;
+
+static drawcmd_t *R_NewDrawCmd(void) {
+  if (numdrawcmds == MAXDRAWCMDS)
+    R_FlushSlices();
+
+  return &drawcmds[numdrawcmds++];
+}
+
+static void R_QueueColumnWith(void (*drawfunc)(void)) {
+  drawcmd_t *cmd;
+
+  cmd = R_NewDrawCmd();
+  cmd->drawfunc = drawfunc;
+  cmd->span = false;
+  cmd->colormap = dc_colormap;
+  cmd->source = dc_source;
+  cmd->translation = dc_translation;
+  cmd->x1 = cmd->x2 = dc_x;
+  cmd->y1 = dc_yl;
+  cmd->y2 = dc_yh;
+  cmd->frac = dc_texturemid;
+  cmd->step = dc_iscale;
+  cmd->fuzzpos = queuedfuzzpos;
+}
+
+static void R_QueueColumn(void) { R_QueueColumnWith(realcolfunc); }
+
+static void R_QueueTranslatedColumn(void) {
+  R_QueueColumnWith(realtranscolfunc);
+}
+
+static void R_QueueFuzzColumn(void) {
+  int yl;
+  int yh;
+
+  R_QueueColumnWith(realfuzzcolfunc);
+
+  // Step fuzzpos the way R_DrawFuzzColumn will,
+  //  so the next fuzz column starts where it should.
+  yl = dc_yl ? dc_yl : 1;
+  yh = dc_yh == viewheight - 1 ? viewheight - 2 : dc_yh;
+
+  if (yh >= yl)
+    queuedfuzzpos = (queuedfuzzpos + yh - yl + 1) % 50;
+}
+
+static void R_QueueSpan(void) {
+  drawcmd_t *cmd;
+
+  cmd = R_NewDrawCmd();
+  cmd->drawfunc = realspanfunc;
+  cmd->span = true;
+  cmd->colormap = ds_colormap;
+  cmd->source = ds_source;
+  cmd->x1 = ds_x1;
+  cmd->x2 = ds_x2;
+  cmd->y1 = cmd->y2 = ds_y;
+  cmd->frac = ds_xfrac;
+  cmd->yfrac = ds_yfrac;
+  cmd->step = ds_xstep;
+  cmd->ystep = ds_ystep;
+}
+
+void R_QueueDrawFuncs(void) {
+  realcolfunc = basecolfunc;
+  realfuzzcolfunc = fuzzcolfunc;
+  realtranscolfunc = transcolfunc;
+  realspanfunc = spanfunc;
+
+  colfunc = basecolfunc = R_QueueColumn;
+  fuzzcolfunc = R_QueueFuzzColumn;
+  transcolfunc = R_QueueTranslatedColumn;
+  spanfunc = R_QueueSpan;
+}
+
+//
+// R_DrawSlice
+// Replay the part of the queue that lies in
+//  columns [x1, x2] of the view.
+//
+static void R_DrawSlice(int x1, int x2) {
+  drawcmd_t *cmd;
+  drawcmd_t *end;
+  unsigned int position;
+  unsigned int step;
+  int skip;
+
+  end = drawcmds + numdrawcmds;
+
+  for (cmd = drawcmds; cmd < end; cmd++) {
+    if (cmd->x2 < x1 || cmd->x1 > x2)
+      continue;
+
+    if (!cmd->span) {
+      dc_colormap = cmd->colormap;
+      dc_source = cmd->source;
+      dc_translation = cmd->translation;
+      dc_x = cmd->x1;
+      dc_yl = cmd->y1;
+      dc_yh = cmd->y2;
+      dc_texturemid = cmd->frac;
+      dc_iscale = cmd->step;
+      fuzzpos = cmd->fuzzpos;
+      cmd->drawfunc();
+      continue;
+    }
+
+    ds_colormap = cmd->colormap;
+    ds_source = cmd->source;
+    ds_y = cmd->y1;
+    ds_x1 = cmd->x1 < x1 ? x1 : cmd->x1;
+    ds_x2 = cmd->x2 > x2 ? x2 : cmd->x2;
+    ds_xfrac = cmd->frac;
+    ds_yfrac = cmd->yfrac;
+    ds_xstep = cmd->step;
+    ds_ystep = cmd->ystep;
+
+    skip = ds_x1 - cmd->x1;
+
+    if (skip) {
+      // The span drawers step a packed 32-bit position,
+      //  x in the top 16 bits and y in the bottom 16 (see
+      //  R_DrawSpan), so carries cross from y into x.
+      // Advance that packed value and unpack it again;
+      //  the drawer repacks it to exactly the same bits.
+      position = ((ds_xfrac << 10) & 0xffff0000) | ((ds_yfrac >> 6) & 0xffff);
+      step = ((ds_xstep << 10) & 0xffff0000) | ((ds_ystep >> 6) & 0xffff);
+      position += skip * step;
+
+      ds_xfrac = (position >> 16) << 6;
+      ds_yfrac = (position & 0xffff) << 6;
+    }
+
+    cmd->drawfunc();
+  }
+}
+
+static void R_SliceBounds(int slice, int *x1, int *x2) {
+  *x1 = (viewwidth * slice) / RENDER_THREADS;
+  *x2 = (viewwidth * (slice + 1)) / RENDER_THREADS - 1;
+}
+
+static void *R_SliceThread(void *arg) {
+  int slice;
+  int frame;
+  int x1;
+  int x2;
+
+  slice = (int)(intptr_t)arg;
+  frame = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&slicemutex);
+    while (sliceframe == frame)
+      pthread_cond_wait(&slicestart, &slicemutex);
+    frame = sliceframe;
+    pthread_mutex_unlock(&slicemutex);
+
+    R_SliceBounds(slice, &x1, &x2);
+    R_DrawSlice(x1, x2);
+
+    pthread_mutex_lock(&slicemutex);
+    if (++slicesdone == RENDER_THREADS - 1)
+      pthread_cond_signal(&slicedone);
+    pthread_mutex_unlock(&slicemutex);
+  }
+
+  return NULL;
+}
+
+void R_InitSlices(void) {
+  int i;
+
+  drawcmds = Z_Malloc(MAXDRAWCMDS * sizeof(*drawcmds), PU_STATIC, NULL);
+
+  for (i = 0; i < RENDER_THREADS - 1; i++) {
+    if (pthread_create(&slicethreads[i], NULL, R_SliceThread,
+                       (void *)(intptr_t)(i + 1))) {
+      I_Error("R_InitSlices: failed to start render thread %i", i + 1);
+    }
+  }
+}
+
+//
+// R_SaveDrawState
+// A flush can come in the middle of setting up a draw
+//  (e.g. from a Z_Malloc in R_GetColumn), so the dc_* and
+//  ds_* state the main thread's replay overwrites is kept
+//  aside and put back afterwards.
+//
+static void R_SaveDrawState(drawcmd_t *column, drawcmd_t *span) {
+  column->colormap = dc_colormap;
+  column->source = dc_source;
+  column->translation = dc_translation;
+  column->x1 = dc_x;
+  column->y1 = dc_yl;
+  column->y2 = dc_yh;
+  column->frac = dc_texturemid;
+  column->step = dc_iscale;
+
+  span->colormap = ds_colormap;
+  span->source = ds_source;
+  span->x1 = ds_x1;
+  span->x2 = ds_x2;
+  span->y1 = ds_y;
+  span->frac = ds_xfrac;
+  span->yfrac = ds_yfrac;
+  span->step = ds_xstep;
+  span->ystep = ds_ystep;
+}
+
+static void R_RestoreDrawState(drawcmd_t *column, drawcmd_t *span) {
+  dc_colormap = column->colormap;
+  dc_source = column->source;
+  dc_translation = column->translation;
+  dc_x = column->x1;
+  dc_yl = column->y1;
+  dc_yh = column->y2;
+  dc_texturemid = column->frac;
+  dc_iscale = column->step;
+
+  ds_colormap = span->colormap;
+  ds_source = span->source;
+  ds_x1 = span->x1;
+  ds_x2 = span->x2;
+  ds_y = span->y1;
+  ds_xfrac = span->frac;
+  ds_yfrac = span->yfrac;
+  ds_xstep = span->step;
+  ds_ystep = span->ystep;
+}
+
+void R_FlushSlices(void) {
+  drawcmd_t column;
+  drawcmd_t span;
+  int x1;
+  int x2;
+
+  if (!numdrawcmds)
+    return;
+
+  pthread_mutex_lock(&slicemutex);
+  slicesdone = 0;
+  sliceframe++;
+  pthread_cond_broadcast(&slicestart);
+  pthread_mutex_unlock(&slicemutex);
+
+  // The main thread draws slice 0 itself.
+  R_SaveDrawState(&column, &span);
+  R_SliceBounds(0, &x1, &x2);
+  R_DrawSlice(x1, x2);
+  R_RestoreDrawState(&column, &span);
+
+  pthread_mutex_lock(&slicemutex);
+  while (slicesdone < RENDER_THREADS - 1)
+    pthread_cond_wait(&slicedone, &slicemutex);
+  pthread_mutex_unlock(&slicemutex);
+
+  numdrawcmds = 0;
+  fuzzpos = queuedfuzzpos;
+}
+
+#endif
@@ -169,6 +169,11 @@ void V_DrawPatch(int x, int y, patch_t *patch) {
       dest = desttop + column->topdelta * SCREENWIDTH;
       count = column->length;
 
+#ifdef TRUECOLOR
+      if (dest_screen == I_VideoBuffer)
+        I_DrawColumn32(x, y + column->topdelta, source, count);
+#endif
+
       while (count--) {
         *dest = *source++;
         dest += SCREENWIDTH;
@@ -225,6 +230,11 @@ void V_DrawPatchFlipped(int x, int y, patch_t *patch) {
       dest = desttop + column->topdelta * SCREENWIDTH;
       count = column->length;
 
+#ifdef TRUECOLOR
+      if (dest_screen == I_VideoBuffer)
+        I_DrawColumn32(x, y + column->topdelta, source, count);
+#endif
+
       while (count--) {
         *dest = *source++;
         dest += SCREENWIDTH;
@@ -692,6 +702,10 @@ void WritePNGfile(char *filename, byte *data, int width, int height,
 //
 
 void V_ScreenShot() {
+#ifdef TRUECOLOR
+  I_SyncVideoBuffer();
+#endif
+
 #ifdef HAVE_LIBPNG
   if (png_screenshots) {
     // TODO: if writing of a PNG screeshot is ever enabled again we'll have to
@@ -20,6 +20,10 @@
 #include "i_system.h"
 #include "doomtype.h"
 
+#ifdef RENDER_THREADS
+#include "r_slice.h"
+#endif
+
 //
 // ZONE MEMORY ALLOCATION
 //
@@ -56,6 +60,9 @@ typedef struct {
 
 memzone_t *mainzone;
 
+// Count of Z_Malloc and Z_Free calls, for -timedemo.
+static unsigned int zoneoperations;
+
 //
 // Z_ClearZone
 //
@@ -112,6 +119,7 @@ void Z_Free(void *ptr) {
   memblock_t *other;
 
   block = (memblock_t *)((byte *)ptr - sizeof(memblock_t));
+  zoneoperations++;
 
   if (block->id != ZONEID)
     I_Error("Z_Free: freed a pointer without ZONEID");
@@ -158,7 +166,7 @@ void Z_Free(void *ptr) {
 //
 #define MINFRAGMENT 64
 
-void *Z_Malloc(int size, int tag, void *user) {
+static void *Z_Allocate(int size, int tag, void *user, boolean fatal) {
   int extra;
   memblock_t *start;
   memblock_t *rover;
@@ -167,6 +175,7 @@ void *Z_Malloc(int size, int tag, void *user) {
   void *result;
 
   size = (size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
+  zoneoperations++;
 
   // scan through the block list,
   // looking for the first free block
@@ -189,6 +198,9 @@ void *Z_Malloc(int size, int tag, void *user) {
   do {
     if (rover == start) {
       // scanned all the way around the list
+      if (!fatal)
+        return NULL;
+
       I_Error("Z_Malloc: failed on allocation of %i bytes", size);
     }
 
@@ -198,6 +210,12 @@ void *Z_Malloc(int size, int tag, void *user) {
         // so move base past it
         base = rover = rover->next;
       } else {
+#ifdef RENDER_THREADS
+        // Queued draws may still read from the block
+        //  (a patch, flat or composite), so draw them first.
+        R_FlushSlices();
+#endif
+
         // free the rover block (adding the size to base)
 
         // the rover can be the base block
@@ -250,6 +268,20 @@ void *Z_Malloc(int size, int tag, void *user) {
   return result;
 }
 
+void *Z_Malloc(int size, int tag, void *user) {
+  return Z_Allocate(size, tag, user, true);
+}
+
+//
+// Z_TryMalloc
+// Like Z_Malloc, but returns NULL when no block is big
+//  enough, rather than stopping with an error. Purgable
+//  blocks may have been thrown out either way.
+//
+void *Z_TryMalloc(int size, int tag, void *user) {
+  return Z_Allocate(size, tag, user, false);
+}
+
 //
 // Z_FreeTags
 //
@@ -405,3 +437,9 @@ int Z_FreeMemory(void) {
 }
 
 unsigned int Z_ZoneSize(void) { return mainzone->size; }
+
+//
+// Z_Operations
+// Returns how many allocations and frees have been made.
+//
+unsigned int Z_Operations(void) { return zoneoperations; }
@@ -0,0 +1,257 @@
+/*
+  A host for the Doom WebAssembly module (`doom.wasm`), as an ES module that runs
+  wherever JavaScript and WebAssembly do: in a browser (see doom.html), or under
+  Node without a browser at all (see ../node/).
+
+  It provides all the imports needed by Doom, apart from what to do with each
+  frame, and calls `tickGame` on a schedule that keeps Doom running at 35 tics
+  per second.
+
+  The shareware WAD is always loaded, and saving of game progress is not
+  supported.
+
+  Usage:
+
+    const doom = await loadDoom(fetch("doom.wasm"), {
+      onFrame: (rgbaPixels, width, height) => { ... },
+    });
+    doom.start();
+*/
+
+// Doom runs at this many tics per second
+export const TICS_PER_SECOND = 35;
+
+// Associate some JavaScript key values (i.e. `KeyboardEvent.key`) with the names of
+// 'Doom key' values that are exported from the WebAssembly module (E.g. when the user
+// presses the "Control" key we want to associate this with the KEY_FIRE value)
+const doomKeyLabelFromJavaScriptKey = new Map([
+  ["ArrowLeft", "KEY_LEFTARROW"],
+  ["ArrowRight", "KEY_RIGHTARROW"],
+  ["ArrowUp", "KEY_UPARROW"],
+  ["ArrowDown", "KEY_DOWNARROW"],
+  [",", "KEY_STRAFE_L"],
+  [".", "KEY_STRAFE_R"],
+  ["Control", "KEY_FIRE"],
+  [" ", "KEY_USE"],
+  ["Shift", "KEY_SHIFT"],
+  ["Tab", "KEY_TAB"],
+  ["Escape", "KEY_ESCAPE"],
+  ["Enter", "KEY_ENTER"],
+  ["Backspace", "KEY_BACKSPACE"],
+  ["Alt", "KEY_ALT"],
+]);
+
+// Translate a JavaScript key value (i.e. `KeyboardEvent.key`) to a Doom key, or `null` if there
+// isn't one, given the value of each of the 'Doom key' labels (e.g. "KEY_FIRE") exported by Doom.
+export function doomKeyForJavaScriptKey(javaScriptKey, doomKeyByLabel) {
+  if (doomKeyLabelFromJavaScriptKey.has(javaScriptKey)) {
+    // Support keys (e.g. "Control") that we've explicitly associated with a Doom key
+    return doomKeyByLabel[doomKeyLabelFromJavaScriptKey.get(javaScriptKey)];
+  } else if (javaScriptKey.length == 1) {
+    // Support keys that are just a single character (e.g. '1'), and in that case
+    // the corresponding Doom key is just the ASCII code of that character.
+    return javaScriptKey.charCodeAt(0);
+  }
+  return null;
+}
+
+// Load the Doom WebAssembly module, instantiate it, and initialize Doom, resolving to a `DoomHost`.
+//
+// `source` is anything that results in the bytes of `doom.wasm`: a `Response` (or a
+// promise of one, e.g. from `fetch`), an `ArrayBuffer` or typed array (e.g. from
+// Node's `fs.readFile`), or an already compiled `WebAssembly.Module`.
+//
+// `options` can contain:
+//  - onFrame(rgbaPixels, width, height): called with each frame Doom draws, as a
+//    `Uint8ClampedArray` of RGBA pixels (ready for an `ImageData`) that's reused for
+//    every frame. Without `onFrame` frames are thrown away without being converted.
+//  - timeInMilliseconds(): the current time, as Doom sees it. Defaults to
+//    `performance.now()`.
+//  - onInfoMessage(message), onErrorMessage(message): called with each message Doom
+//    reports. Default to logging to the console.
+export async function loadDoom(source, options = {}) {
+  const host = new DoomHost(options);
+  const imports = host._imports();
+
+  source = await source;
+  let instance;
+  if (source instanceof WebAssembly.Module) {
+    instance = await WebAssembly.instantiate(source, imports);
+  } else if (typeof Response !== "undefined" && source instanceof Response) {
+    ({ instance } = await WebAssembly.instantiateStreaming(source, imports));
+  } else {
+    ({ instance } = await WebAssembly.instantiate(source, imports));
+  }
+
+  host._attach(instance);
+  return host;
+}
+
+export class DoomHost {
+  constructor(options) {
+    this.onFrame = options.onFrame ?? null;
+    this.timeInMilliseconds = options.timeInMilliseconds ?? (() => performance.now());
+    this.onInfoMessage = options.onInfoMessage ?? ((message) => console.log(`[Doom stdout] ${message}`));
+    this.onErrorMessage = options.onErrorMessage ?? ((message) => console.error(`[Doom stderr] ${message}`));
+
+    this.exports = null;
+    this.width = 0;
+    this.height = 0;
+    this.framesDrawn = 0;
+
+    this._memory = null;
+    // A view of Doom's frame buffer, one Uint32 per pixel, only rebuilt when Doom's memory
+    // grows (which detaches the memory's old ArrayBuffer, and so every view of it)
+    this._frameBuffer = null;
+    this._rgbaPixels = null;
+    this._rgbaPixelsAsUint32 = null;
+    this._timer = null;
+    // The first time reported to Doom, from which it counts tics
+    this._baseTime = null;
+  }
+
+  // The value of each of the 'Doom key' labels (e.g. "KEY_FIRE") exported by Doom
+  get doomKeyByLabel() {
+    const doomKeyByLabel = {};
+    for (const label of doomKeyLabelFromJavaScriptKey.values()) {
+      doomKeyByLabel[label] = this.exports[label].value;
+    }
+    return doomKeyByLabel;
+  }
+
+  // Translate a JavaScript key value (i.e. `KeyboardEvent.key`) to a Doom key, or `null` if there isn't one.
+  doomKeyFor(javaScriptKey) {
+    return doomKeyForJavaScriptKey(javaScriptKey, this.doomKeyByLabel);
+  }
+
+  reportKeyDown(doomKey) {
+    this.exports.reportKeyDown(doomKey);
+  }
+
+  reportKeyUp(doomKey) {
+    this.exports.reportKeyUp(doomKey);
+  }
+
+  // Run Doom until it's caught up with the current time, which is at least one tic.
+  tick() {
+    this.exports.tickGame();
+  }
+
+  // Call `tick` each time a tic is due, until `stop` is called.
+  //
+  // `tickGame` waits (busily) for the next tic if it's called before that tic is due,
+  // so rather than being called on a fixed interval, which drifts against Doom's own
+  // clock, each call is scheduled for exactly when Doom's next tic is due. After a
+  // stall (e.g. a hidden browser tab) Doom runs every tic it missed in one call.
+  start() {
+    if (this._timer !== null) {
+      return;
+    }
+    const scheduleNextTick = () => {
+      this._timer = setTimeout(run, Math.max(0, this._nextTicDue() - this.timeInMilliseconds()));
+    };
+    const run = () => {
+      this.tick();
+      scheduleNextTick();
+    };
+    scheduleNextTick();
+  }
+
+  stop() {
+    clearTimeout(this._timer);
+    this._timer = null;
+  }
+
+  // The time, in milliseconds, at which Doom's next tic is due.
+  //
+  // Doom counts tics from the first time it asks what time it is, and tic `n` is due
+  // once `n * 1000 / TICS_PER_SECOND` whole milliseconds have passed since then.
+  _nextTicDue() {
+    if (this._baseTime === null) {
+      return this.timeInMilliseconds();
+    }
+    const elapsed = Math.trunc(this.timeInMilliseconds()) - this._baseTime;
+    const nextTic = Math.floor(elapsed * TICS_PER_SECOND / 1000) + 1;
+    return this._baseTime + Math.ceil(nextTic * 1000 / TICS_PER_SECOND);
+  }
+
+  _attach(instance) {
+    this.exports = instance.exports;
+    this._memory = instance.exports.memory;
+    this.exports.initGame();
+  }
+
+  _imports() {
+    return {
+      "loading": {
+        "onGameInit": (width, height) => this._onGameInit(width, height),
+        // Provide no WAD data, so the module defaults to using the Doom Shareware WAD
+        "wadSizes": () => {},
+        "readWads": () => {},
+      },
+      "ui": {
+        "drawFrame": (indexOfFrameBuffer) => this._drawFrame(indexOfFrameBuffer),
+      },
+      "runtimeControl": {
+        "timeInMilliseconds": () => this._timeForDoom(),
+      },
+      "console": {
+        "onInfoMessage": (messagePtr, length) => this.onInfoMessage(this._readString(messagePtr, length)),
+        "onErrorMessage": (messagePtr, length) => this.onErrorMessage(this._readString(messagePtr, length)),
+      },
+      "gameSaving": {
+        // Provide no support for saving games
+        "sizeOfSaveGame": () => 0,
+        "readSaveGame": () => 0,
+        "writeSaveGame": () => 0,
+      },
+    };
+  }
+
+  _timeForDoom() {
+    const time = Math.trunc(this.timeInMilliseconds());
+    if (this._baseTime === null) {
+      this._baseTime = time;
+    }
+    return BigInt(time);
+  }
+
+  _onGameInit(width, height) {
+    this.width = width;
+    this.height = height;
+    this._rgbaPixels = new Uint8ClampedArray(width * height * 4);
+    this._rgbaPixelsAsUint32 = new Uint32Array(this._rgbaPixels.buffer);
+  }
+
+  _drawFrame(indexOfFrameBuffer) {
+    this.framesDrawn++;
+    if (this.onFrame === null) {
+      return;
+    }
+
+    if (this._frameBuffer === null || this._frameBuffer.buffer !== this._memory.buffer || this._frameBuffer.byteOffset !== indexOfFrameBuffer) {
+      this._frameBuffer = new Uint32Array(this._memory.buffer, indexOfFrameBuffer, this.width * this.height);
+    }
+
+    // Doom frame buffer pixels are 32-bit, with their 8-bit color components logically ordered
+    // "ARGB", i.e. 0xAARRGGBB as a Uint32. The pixels in an ImageData are made up of 8-bit color
+    // components ordered "RGBA", from low to high index, which is 0xAABBGGRR as a Uint32 (as typed
+    // arrays use the platform's byte order, and every platform that runs JavaScript in practice
+    // is little-endian, as is WebAssembly). So a pixel at a time, swap red and blue, and make the
+    // pixel fully opaque.
+    const source = this._frameBuffer;
+    const destination = this._rgbaPixelsAsUint32;
+    for (let i = 0; i < source.length; i++) {
+      const pixel = source[i];
+      destination[i] = 0xff000000 | ((pixel & 0xff) << 16) | (pixel & 0xff00) | ((pixel >>> 16) & 0xff);
+    }
+
+    this.onFrame(this._rgbaPixels, this.width, this.height);
+  }
+
+  // Interpret a chunk of bytes, in Doom's memory, as a UTF-8 string
+  _readString(offset, length) {
+    const bytes = new Uint8Array(this._memory.buffer, offset, length);
+    return new TextDecoder("utf-8", { fatal: false }).decode(bytes);
+  }
+}
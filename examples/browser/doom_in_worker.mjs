@@ -0,0 +1,165 @@
+/*
+  Runs Doom in a dedicated worker (see doom_worker.mjs), and hands its frames to
+  whoever paints them, and key events to it.
+
+  Works with a browser `Worker` or a Node `worker_threads` Worker.
+
+  Usage:
+
+    const doom = await startDoomInWorker(
+      new Worker(new URL("./doom_worker.mjs", import.meta.url), { type: "module" }),
+      "assets/doom.wasm");
+    // Then, e.g. on every animation frame:
+    doom.paintLatestFrame((rgbaPixels, width, height) => { ... });
+*/
+
+import { doomKeyForJavaScriptKey } from "./doom_host.mjs";
+
+// The number of frame buffers shared with the worker, when frames are shared
+export const NUMBER_OF_FRAME_BUFFERS = 3;
+// Set alongside the index of the latest finished frame, until that frame's been painted
+export const FRAME_IS_NEW = 0x100;
+
+// Start Doom in `worker`, resolving to a `DoomInWorker` once Doom has been initialized.
+//
+// `source` is passed along to the worker: the URL of `doom.wasm`, its bytes, or a
+// compiled `WebAssembly.Module`.
+//
+// `options` can contain:
+//  - sharedFrames: whether to hand frames over in a SharedArrayBuffer. Defaults to
+//    whether SharedArrayBuffer can be used (i.e. in a browser, whether the page is
+//    cross-origin isolated).
+//  - fastClock: run Doom as fast as it can, rather than in real time.
+export function startDoomInWorker(worker, source, options = {}) {
+  const sharedFrames = options.sharedFrames ?? (typeof SharedArrayBuffer !== "undefined" && (globalThis.crossOriginIsolated ?? true));
+  const doom = new DoomInWorker(worker);
+  return doom._start({ type: "start", source, sharedFrames, fastClock: options.fastClock ?? false });
+}
+
+export class DoomInWorker {
+  constructor(worker) {
+    this.worker = worker;
+    this.width = 0;
+    this.height = 0;
+    this.framesPainted = 0;
+
+    this._doomKeyByLabel = null;
+    this._pendingKeyEvents = [];
+    this._onMessage = () => {};
+    this._onError = () => {};
+
+    // Used when frames are shared
+    this._frames = null;
+    this._latestFrame = null;
+    this._paintingFrame = 1;
+
+    // Used when frames aren't shared: the latest frame posted, not yet painted
+    this._postedFrame = null;
+
+    // Browser workers are EventTargets, Node workers are EventEmitters
+    const listen = (type, listener) => worker.addEventListener ? worker.addEventListener(type, listener) : worker.on(type, listener);
+    listen("message", (event) => this._handleMessage(worker.addEventListener ? event.data : event));
+    listen("error", (error) => this._onError(error.message ?? error));
+  }
+
+  // Translate a JavaScript key value (i.e. `KeyboardEvent.key`) to a Doom key, or `null` if there isn't one.
+  doomKeyFor(javaScriptKey) {
+    return doomKeyForJavaScriptKey(javaScriptKey, this._doomKeyByLabel);
+  }
+
+  reportKeyDown(doomKey) {
+    this._queueKeyEvent(true, doomKey);
+  }
+
+  reportKeyUp(doomKey) {
+    this._queueKeyEvent(false, doomKey);
+  }
+
+  // If there's a frame that hasn't been painted yet, call `paint(rgbaPixels, width, height)`
+  // with it (the pixels are only valid until `paint` returns) and return true, otherwise
+  // return false.
+  paintLatestFrame(paint) {
+    if (this._frames !== null) {
+      if (!(Atomics.load(this._latestFrame, 0) & FRAME_IS_NEW)) {
+        return false;
+      }
+      // Only this side clears FRAME_IS_NEW, so what's swapped in is new
+      this._paintingFrame = Atomics.exchange(this._latestFrame, 0, this._paintingFrame) & ~FRAME_IS_NEW;
+      paint(this._frames[this._paintingFrame], this.width, this.height);
+    } else {
+      if (this._postedFrame === null) {
+        return false;
+      }
+      const pixels = this._postedFrame;
+      this._postedFrame = null;
+      paint(new Uint8ClampedArray(pixels), this.width, this.height);
+      this.worker.postMessage({ type: "returnFrame", pixels }, [pixels]);
+    }
+    this.framesPainted++;
+    return true;
+  }
+
+  // Stop running Doom, resolving once the worker has stopped calling into it.
+  stop() {
+    return new Promise((resolve) => {
+      this._onMessage = (message) => message.type === "stopped" && resolve();
+      this._flushKeyEvents();
+      this.worker.postMessage({ type: "stop" });
+    });
+  }
+
+  _start(startMessage) {
+    return new Promise((resolve, reject) => {
+      this._onError = reject;
+      this._onMessage = (message) => {
+        if (message.type === "ready") {
+          this._onError = (error) => console.error(`[Doom worker] ${error}`);
+          resolve(this);
+        }
+      };
+      this.worker.postMessage(startMessage);
+    });
+  }
+
+  _handleMessage(message) {
+    switch (message.type) {
+      case "ready":
+        this.width = message.width;
+        this.height = message.height;
+        this._doomKeyByLabel = message.doomKeyByLabel;
+        if (message.sharedFrames !== null) {
+          const frameSize = this.width * this.height * 4;
+          this._frames = Array.from({ length: NUMBER_OF_FRAME_BUFFERS }, (_, i) => new Uint8ClampedArray(message.sharedFrames, i * frameSize, frameSize));
+          this._latestFrame = new Int32Array(message.control);
+        }
+        break;
+      case "frame":
+        // A frame that was never painted is of no more use, and goes straight back
+        if (this._postedFrame !== null) {
+          this.worker.postMessage({ type: "returnFrame", pixels: this._postedFrame }, [this._postedFrame]);
+        }
+        this._postedFrame = message.pixels;
+        break;
+      case "error":
+        this._onError(message.message);
+        break;
+    }
+    this._onMessage(message);
+  }
+
+  // Key events are sent to the worker in batches, one per task (e.g. every key event
+  // handled before the page next paints), rather than one message each.
+  _queueKeyEvent(isDown, doomKey) {
+    if (this._pendingKeyEvents.length === 0) {
+      queueMicrotask(() => this._flushKeyEvents());
+    }
+    this._pendingKeyEvents.push([isDown, doomKey]);
+  }
+
+  _flushKeyEvents() {
+    if (this._pendingKeyEvents.length > 0) {
+      this.worker.postMessage({ type: "keys", events: this._pendingKeyEvents });
+      this._pendingKeyEvents = [];
+    }
+  }
+}
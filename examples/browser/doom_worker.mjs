@@ -0,0 +1,153 @@
+/*
+  Runs Doom in a dedicated worker, so that a long tic (e.g. loading a level, or
+  the screen wipe between levels) never blocks the page's input or painting.
+
+  This is the worker's side; see doom_in_worker.mjs for the side that starts the
+  worker and talks to it. It runs as a module Worker in a browser, or as a
+  `worker_threads` Worker under Node.
+
+  Frames are handed to the other side through three buffers of RGBA pixels in a
+  SharedArrayBuffer, when SharedArrayBuffer is available (which in a browser
+  needs the page to be cross-origin isolated). Doom draws into one buffer, the
+  other side paints from another, and the latest finished frame waits in the
+  third. Otherwise each frame is posted as a transferred ArrayBuffer, which the
+  other side posts back once it's done with it.
+
+  Messages received:
+    { type: "start", source, sharedFrames, fastClock }
+      - source: the URL of `doom.wasm` (compiled via module_cache.mjs), its
+        bytes, or a compiled `WebAssembly.Module`
+      - sharedFrames: whether to hand frames over in a SharedArrayBuffer
+      - fastClock: advance Doom's clock a millisecond each time Doom asks for
+        the time, rather than following `performance.now()`, so Doom runs as
+        fast as it can (for benchmarks and tests)
+    { type: "keys", events: [[isDown, doomKey], ...] }
+    { type: "returnFrame", pixels } (when frames aren't shared)
+    { type: "stop" }
+
+  Messages sent:
+    { type: "ready", width, height, doomKeyByLabel, sharedFrames, control }
+      - sharedFrames: the SharedArrayBuffer holding the three frame buffers, or
+        null if frames are posted instead
+      - control: a SharedArrayBuffer holding one Int32, the index of the buffer
+        holding the latest finished frame, along with FRAME_IS_NEW
+    { type: "frame", pixels } (when frames aren't shared)
+    { type: "error", message }
+    { type: "stopped" }
+*/
+
+import { loadDoom } from "./doom_host.mjs";
+import { compileDoomModule } from "./module_cache.mjs";
+import { NUMBER_OF_FRAME_BUFFERS, FRAME_IS_NEW } from "./doom_in_worker.mjs";
+
+// The most frames posted, and not yet posted back, before frames are dropped
+const MAX_FRAMES_IN_FLIGHT = 3;
+
+// A browser worker's global scope, or Node's `parentPort`, which both have
+// `postMessage` and `addEventListener("message", ...)`
+const port = typeof globalThis.WorkerGlobalScope !== "undefined" ? globalThis : (await import("node:worker_threads")).parentPort;
+
+let doom = null;
+// Set when running with a fast clock, which has Doom tick back to back
+let fastClockTimer = null;
+
+// Used when frames are shared
+let frames = null;
+let latestFrame = null;
+let drawingFrame = 0;
+
+// Used when frames aren't shared
+let returnedFrames = [];
+let framesInFlight = 0;
+
+async function start({ source, sharedFrames, fastClock }) {
+  const module = typeof source === "string" ? await compileDoomModule(source) : source;
+
+  let time = 0;
+  doom = await loadDoom(module, {
+    onFrame: sharedFrames ? shareFrame : postFrame,
+    timeInMilliseconds: fastClock ? () => (time += 1) : undefined,
+    onInfoMessage: () => {},
+  });
+
+  const frameSize = doom.width * doom.height * 4;
+  let control = null;
+  if (sharedFrames) {
+    const buffer = new SharedArrayBuffer(frameSize * NUMBER_OF_FRAME_BUFFERS);
+    frames = Array.from({ length: NUMBER_OF_FRAME_BUFFERS }, (_, i) => new Uint8ClampedArray(buffer, i * frameSize, frameSize));
+    control = new SharedArrayBuffer(4);
+    latestFrame = new Int32Array(control);
+    // The other side starts out painting from buffer 1
+    Atomics.store(latestFrame, 0, 2);
+    drawingFrame = 0;
+  }
+
+  port.postMessage({
+    type: "ready",
+    width: doom.width,
+    height: doom.height,
+    doomKeyByLabel: doom.doomKeyByLabel,
+    sharedFrames: sharedFrames ? frames[0].buffer : null,
+    control,
+  });
+
+  if (fastClock) {
+    // Doom's clock has nothing to do with real time, so there's no tic worth waiting
+    // for, but messages (e.g. key events) are still handled between tics
+    const run = () => {
+      doom.tick();
+      fastClockTimer = setTimeout(run, 0);
+    };
+    fastClockTimer = setTimeout(run, 0);
+  } else {
+    doom.start();
+  }
+}
+
+function shareFrame(rgbaPixels) {
+  if (frames === null) {
+    return; // A frame drawn by `initGame`, before the buffers exist
+  }
+  frames[drawingFrame].set(rgbaPixels);
+  drawingFrame = Atomics.exchange(latestFrame, 0, drawingFrame | FRAME_IS_NEW) & ~FRAME_IS_NEW;
+}
+
+function postFrame(rgbaPixels) {
+  // If the other side has fallen behind, it only needs the latest frame anyway
+  if (framesInFlight >= MAX_FRAMES_IN_FLIGHT) {
+    return;
+  }
+  const pixels = returnedFrames.pop() ?? new ArrayBuffer(rgbaPixels.byteLength);
+  new Uint8ClampedArray(pixels).set(rgbaPixels);
+  framesInFlight++;
+  port.postMessage({ type: "frame", pixels }, [pixels]);
+}
+
+port.addEventListener("message", async ({ data: message }) => {
+  try {
+    switch (message.type) {
+      case "start":
+        await start(message);
+        break;
+      case "keys":
+        // Every key event since the last batch, reported before the next tic
+        for (const [isDown, doomKey] of message.events) {
+          isDown ? doom.reportKeyDown(doomKey) : doom.reportKeyUp(doomKey);
+        }
+        break;
+      case "returnFrame":
+        framesInFlight--;
+        returnedFrames.push(message.pixels);
+        break;
+      case "stop":
+        clearTimeout(fastClockTimer);
+        doom?.stop();
+        port.postMessage({ type: "stopped" });
+        break;
+    }
+  } catch (error) {
+    port.postMessage({ type: "error", message: `${error}\n${error.stack ?? ""}` });
+  }
+});
+// Node's MessagePort only starts delivering messages once it's asked to
+port.start?.();
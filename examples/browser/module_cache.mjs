@@ -0,0 +1,99 @@
+/*
+  Compiles the Doom WebAssembly module, caching it in IndexedDB so later page
+  loads needn't download it (and, where the browser allows it, needn't compile
+  it) again.
+
+  Browsers differ in what they'll store in IndexedDB: some store a compiled
+  `WebAssembly.Module` as is, most refuse to. So the compiled module is stored if
+  it can be, and otherwise the bytes of the module are.
+
+  Each cached module is keyed by its URL and by what the server says identifies
+  that version of it (its ETag, or failing that its Last-Modified and
+  Content-Length headers), as found by a HEAD request. So a changed `doom.wasm` is
+  downloaded and cached afresh, and a cached module costs just one small request
+  to use.
+
+  Where there's no IndexedDB (e.g. under Node) the module is just compiled.
+*/
+
+const DATABASE_NAME = "doom.wasm";
+const DATABASE_VERSION = 1;
+const STORE_NAME = "modules";
+
+// Resolve to a compiled `WebAssembly.Module` of the Doom WebAssembly module at `url`.
+export async function compileDoomModule(url) {
+  if (typeof indexedDB === "undefined") {
+    return WebAssembly.compileStreaming(fetch(url));
+  }
+
+  let database = null;
+  let key = null;
+  try {
+    database = await openDatabase();
+    key = await cacheKeyFor(url);
+    const cached = await request(transaction(database, "readonly").get(key));
+    if (cached instanceof WebAssembly.Module) {
+      return cached;
+    } else if (cached !== undefined) {
+      return await WebAssembly.compile(cached);
+    }
+  } catch (error) {
+    // A cache that doesn't work is no cache at all, rather than an error
+    console.warn(`Failed to read the module cache: ${error}`);
+  }
+
+  const bytes = await (await fetch(url)).arrayBuffer();
+  const module = await WebAssembly.compile(bytes);
+
+  if (database !== null && key !== null) {
+    try {
+      await storeInCache(database, key, module, bytes);
+    } catch (error) {
+      console.warn(`Failed to write to the module cache: ${error}`);
+    }
+  }
+  return module;
+}
+
+async function cacheKeyFor(url) {
+  const response = await fetch(url, { method: "HEAD", cache: "no-cache" });
+  const headers = response.headers;
+  const version = headers.get("ETag") ?? `${headers.get("Last-Modified")}/${headers.get("Content-Length")}`;
+  return `${new URL(url, globalThis.location?.href).href} ${version}`;
+}
+
+async function storeInCache(database, key, module, bytes) {
+  // Only the latest version of each module is worth keeping
+  const url = key.slice(0, key.indexOf(" "));
+  const keys = await request(transaction(database, "readonly").getAllKeys());
+  const stale = keys.filter((k) => k.startsWith(`${url} `) && k !== key);
+
+  try {
+    // Structured cloning of a `WebAssembly.Module` throws (a "DataCloneError") in
+    // browsers that won't store one
+    await request(transaction(database, "readwrite").put(module, key));
+  } catch {
+    await request(transaction(database, "readwrite").put(bytes, key));
+  }
+
+  const store = transaction(database, "readwrite");
+  await Promise.all(stale.map((k) => request(store.delete(k))));
+}
+
+function openDatabase() {
+  const open = indexedDB.open(DATABASE_NAME, DATABASE_VERSION);
+  open.onupgradeneeded = () => open.result.createObjectStore(STORE_NAME);
+  return request(open);
+}
+
+function transaction(database, mode) {
+  return database.transaction(STORE_NAME, mode).objectStore(STORE_NAME);
+}
+
+// Resolve to the result of an IndexedDB request
+function request(idbRequest) {
+  return new Promise((resolve, reject) => {
+    idbRequest.onsuccess = () => resolve(idbRequest.result);
+    idbRequest.onerror = () => reject(idbRequest.error);
+  });
+}
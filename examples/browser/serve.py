@@ -0,0 +1,27 @@
+"""
+Serves this folder over HTTP, as `python3 -m http.server` does, but with the
+headers that make a page cross-origin isolated, so doom.html can share frames
+with the Worker running Doom through a SharedArrayBuffer.
+
+Usage: python3 serve.py [port]
+"""
+
+import sys
+from functools import partial
+from http.server import SimpleHTTPRequestHandler, ThreadingHTTPServer
+
+
+class CrossOriginIsolatedRequestHandler(SimpleHTTPRequestHandler):
+  def end_headers(self):
+    self.send_header('Cross-Origin-Opener-Policy', 'same-origin')
+    self.send_header('Cross-Origin-Embedder-Policy', 'require-corp')
+    super().end_headers()
+
+
+# `.mjs` files must be served as JavaScript to be loaded as modules
+CrossOriginIsolatedRequestHandler.extensions_map['.mjs'] = 'text/javascript'
+
+if __name__ == '__main__':
+  port = int(sys.argv[1]) if len(sys.argv) > 1 else 8000
+  with ThreadingHTTPServer(('', port), CrossOriginIsolatedRequestHandler) as server:
+    server.serve_forever()
@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "doom_exports.h"
+#include "doom_utils.h"
+#include "imports_headless/headless_state.h"
+
+/*
+  Runs many independent instances of the Doom WebAssembly module, headless, on a
+  pool of worker threads, and reports the aggregate tics per second and a
+  checksum of the frames drawn by each instance.
+
+  Each instance runs for a fixed number of tics, pressing and releasing keys as
+  described by its own input script. An input script is a text file with one
+  key event per line:
+
+    <tic> down|up <key>
+
+  where <tic> is the number of tics run before the event is reported, and <key>
+  is either the name of a DoomKeyLabel (e.g. KEY_FIRE) or a single character
+  (e.g. y). Lines starting with # are ignored.
+
+  Instances are split evenly between the workers up front, and a worker that
+  runs out of instances of its own takes them from other workers that haven't
+  got to theirs yet. Each instance has its own Wasmtime store, which is only
+  ever used by the worker that's running it.
+*/
+
+#define DEFAULT_NUMBER_OF_TICS 1000
+
+typedef struct input_event {
+  int tic;
+  bool down;
+  bool isLabel;
+  enum DoomKeyLabel label;
+  int32_t doomKey;
+} input_event_t;
+
+typedef struct batch_instance {
+  const char *inputPath;
+  input_event_t *events;
+  int numberOfEvents;
+  headless_state_t state;
+  doom_module_error_t *error;
+} batch_instance_t;
+
+typedef struct batch batch_t;
+
+typedef struct worker {
+  batch_t *batch;
+  pthread_t thread;
+  // The next of this worker's instances to run, whether by this worker or
+  // another one. All of them have been taken once `next` reaches `end`.
+  atomic_int next;
+  int end;
+} worker_t;
+
+struct batch {
+  doom_module_t *module;
+  doom_module_config_t config;
+  int tics;
+  batch_instance_t *instances;
+  int numberOfInstances;
+  worker_t *workers;
+  int numberOfWorkers;
+};
+
+static uint64_t nanoseconds_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static struct {
+  const char *name;
+  enum DoomKeyLabel label;
+} doomKeyLabelNames[] = {
+    {"KEY_ALT", KEY_ALT},
+    {"KEY_BACKSPACE", KEY_BACKSPACE},
+    {"KEY_DOWNARROW", KEY_DOWNARROW},
+    {"KEY_ENTER", KEY_ENTER},
+    {"KEY_ESCAPE", KEY_ESCAPE},
+    {"KEY_FIRE", KEY_FIRE},
+    {"KEY_LEFTARROW", KEY_LEFTARROW},
+    {"KEY_RIGHTARROW", KEY_RIGHTARROW},
+    {"KEY_SHIFT", KEY_SHIFT},
+    {"KEY_STRAFE_L", KEY_STRAFE_L},
+    {"KEY_STRAFE_R", KEY_STRAFE_R},
+    {"KEY_TAB", KEY_TAB},
+    {"KEY_UPARROW", KEY_UPARROW},
+    {"KEY_USE", KEY_USE},
+};
+
+// Reads the input script at `path` into `instance`, with its events sorted by
+// tic.
+static doom_module_error_t *read_input_script(const char *path,
+                                              batch_instance_t *instance) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return doom_module_error_new("Failed to open input script '%s'", path);
+  }
+
+  int capacity = 0;
+  char line[256];
+  for (int lineNumber = 1; fgets(line, sizeof(line), file); lineNumber++) {
+    int tic;
+    char action[8];
+    char key[32];
+    if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+      continue;
+    }
+    if (sscanf(line, "%d %7s %31s", &tic, action, key) != 3 || tic < 0 ||
+        (strcmp(action, "down") != 0 && strcmp(action, "up") != 0)) {
+      fclose(file);
+      return doom_module_error_new("Bad event on line %d of '%s'", lineNumber,
+                                   path);
+    }
+
+    input_event_t event = {0};
+    event.tic = tic;
+    event.down = strcmp(action, "down") == 0;
+    if (strlen(key) == 1) {
+      event.doomKey = (uint8_t)key[0];
+    } else {
+      int i = 0;
+      while (i < ARRAY_LENGTH(doomKeyLabelNames) &&
+             strcmp(doomKeyLabelNames[i].name, key) != 0) {
+        i++;
+      }
+      if (i == ARRAY_LENGTH(doomKeyLabelNames)) {
+        fclose(file);
+        return doom_module_error_new("Unknown key '%s' on line %d of '%s'",
+                                     key, lineNumber, path);
+      }
+      event.isLabel = true;
+      event.label = doomKeyLabelNames[i].label;
+    }
+
+    // Keep the events sorted by tic, with events on the same tic in the order
+    // they were written
+    if (instance->numberOfEvents == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      instance->events =
+          realloc(instance->events, capacity * sizeof(input_event_t));
+    }
+    int i = instance->numberOfEvents++;
+    while (i > 0 && instance->events[i - 1].tic > tic) {
+      instance->events[i] = instance->events[i - 1];
+      i--;
+    }
+    instance->events[i] = event;
+  }
+
+  fclose(file);
+  instance->inputPath = path;
+  return NULL;
+}
+
+static doom_module_error_t *run_instance(batch_t *batch,
+                                         batch_instance_t *batchInstance) {
+  doom_module_instance_t *instance = NULL;
+  doom_module_error_t *error = doom_module_instance_new_from_module(
+      batch->module, &batch->config, &instance);
+  if (error) {
+    return error;
+  }
+
+  doom_module_context_t *context = doom_module_instance_context(instance);
+  batchInstance->state.checksumFrames = true;
+  batchInstance->state.quiet = true;
+  doom_module_context_set_host_state(context, &batchInstance->state);
+
+  error = initGame(context);
+
+  int e = 0;
+  for (int tic = 0; !error && tic < batch->tics; tic++) {
+    for (; !error && e < batchInstance->numberOfEvents &&
+           batchInstance->events[e].tic <= tic;
+         e++) {
+      input_event_t *event = &batchInstance->events[e];
+      int32_t doomKey = event->doomKey;
+      if (event->isLabel) {
+        error = doomKeyForLabel(context, event->label, &doomKey);
+      }
+      if (!error) {
+        error = event->down ? reportKeyDown(context, doomKey)
+                            : reportKeyUp(context, doomKey);
+      }
+    }
+
+    if (!error) {
+      error = tickGame(context);
+    }
+  }
+
+  doom_module_instance_delete(instance);
+  return error;
+}
+
+// Returns the index of the next instance to run, or -1 if there are none left.
+static int take_instance(worker_t *worker) {
+  batch_t *batch = worker->batch;
+  int self = worker - batch->workers;
+
+  // This worker's own instances first, then those of the other workers
+  for (int i = 0; i < batch->numberOfWorkers; i++) {
+    worker_t *victim = &batch->workers[(self + i) % batch->numberOfWorkers];
+    if (atomic_load(&victim->next) < victim->end) {
+      int index = atomic_fetch_add(&victim->next, 1);
+      if (index < victim->end) {
+        return index;
+      }
+    }
+  }
+  return -1;
+}
+
+static void *run_worker(void *arg) {
+  worker_t *worker = (worker_t *)arg;
+  for (int index = take_instance(worker); index >= 0;
+       index = take_instance(worker)) {
+    batch_instance_t *instance = &worker->batch->instances[index];
+    instance->error = run_instance(worker->batch, instance);
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Usage: %s path-to-Doom-WebAssembly-module [-j workers] "
+           "[-n instances] [-t tics] [input-script ...]\n\n"
+           "With no input scripts, runs instances that press no keys. With "
+           "input scripts, runs one instance per script.\n",
+           argv[0]);
+    return 1;
+  }
+
+  batch_t batch = {0};
+  batch.config.numberOfWadFiles = 0;
+  batch.config.pathsToWadFiles = NULL;
+  batch.tics = DEFAULT_NUMBER_OF_TICS;
+  batch.numberOfWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+  batch.numberOfInstances = batch.numberOfWorkers;
+
+  int argi = 2;
+  for (; argi + 1 < argc && argv[argi][0] == '-'; argi += 2) {
+    int value = atoi(argv[argi + 1]);
+    if (strcmp(argv[argi], "-j") == 0) {
+      batch.numberOfWorkers = value;
+    } else if (strcmp(argv[argi], "-n") == 0) {
+      batch.numberOfInstances = value;
+    } else if (strcmp(argv[argi], "-t") == 0) {
+      batch.tics = value;
+    } else {
+      break;
+    }
+  }
+  int numberOfScripts = argc - argi;
+  if (numberOfScripts > 0) {
+    batch.numberOfInstances = numberOfScripts;
+  }
+  if (batch.numberOfWorkers <= 0 || batch.numberOfInstances <= 0 ||
+      batch.tics <= 0) {
+    fprintf(stderr, "The number of workers, instances, and tics must each be "
+                    "greater than 0\n");
+    return 1;
+  }
+  if (batch.numberOfWorkers > batch.numberOfInstances) {
+    batch.numberOfWorkers = batch.numberOfInstances;
+  }
+
+  batch.instances = calloc(batch.numberOfInstances, sizeof(batch_instance_t));
+  doom_module_error_t *error = NULL;
+  for (int i = 0; !error && i < numberOfScripts; i++) {
+    error = read_input_script(argv[argi + i], &batch.instances[i]);
+  }
+
+  // No more instances than there are workers ever exist at once
+  if (!error) {
+    error = doom_module_new(argv[1], batch.numberOfWorkers, &batch.module);
+  }
+
+  if (!error) {
+    printf("Running %d instances for %d tics each on %d workers...\n",
+           batch.numberOfInstances, batch.tics, batch.numberOfWorkers);
+
+    batch.workers = calloc(batch.numberOfWorkers, sizeof(worker_t));
+    for (int i = 0; i < batch.numberOfWorkers; i++) {
+      worker_t *worker = &batch.workers[i];
+      worker->batch = &batch;
+      atomic_init(&worker->next, (int)((int64_t)batch.numberOfInstances * i /
+                                       batch.numberOfWorkers));
+      worker->end = (int64_t)batch.numberOfInstances * (i + 1) /
+                    batch.numberOfWorkers;
+    }
+
+    uint64_t start = nanoseconds_now();
+    int numberOfThreads = 0;
+    for (; numberOfThreads < batch.numberOfWorkers; numberOfThreads++) {
+      worker_t *worker = &batch.workers[numberOfThreads];
+      if (pthread_create(&worker->thread, NULL, run_worker, worker) != 0) {
+        break;
+      }
+    }
+    if (numberOfThreads == 0) {
+      // Still make progress, on this thread
+      run_worker(&batch.workers[0]);
+    }
+    for (int i = 0; i < numberOfThreads; i++) {
+      pthread_join(batch.workers[i].thread, NULL);
+    }
+    uint64_t elapsed = nanoseconds_now() - start;
+
+    for (int i = 0; i < batch.numberOfInstances; i++) {
+      batch_instance_t *instance = &batch.instances[i];
+      if (instance->error) {
+        printf("instance %d: error: %s\n", i, instance->error->message);
+        if (!error) {
+          error = doom_module_error_new("%d: %s", i, instance->error->message);
+        }
+        doom_module_error_delete(instance->error);
+      } else {
+        printf("instance %d: %" PRIu64 " frames, checksum %016" PRIx64 "%s%s\n",
+               i, instance->state.framesDrawn, instance->state.framesChecksum,
+               instance->inputPath ? ", input " : "",
+               instance->inputPath ? instance->inputPath : "");
+      }
+    }
+
+    double totalTics = (double)batch.tics * batch.numberOfInstances;
+    printf("%.0f tics in %.2f s: %.0f tics per second\n", totalTics,
+           elapsed / 1e9, totalTics / (elapsed / 1e9));
+
+    free(batch.workers);
+    doom_module_delete(batch.module);
+  }
+
+  for (int i = 0; i < batch.numberOfInstances; i++) {
+    free(batch.instances[i].events);
+  }
+  free(batch.instances);
+
+  if (error) {
+    fprintf(stderr, "An error occurred!\n%s\n", error->message);
+    doom_module_error_delete(error);
+    return 1;
+  }
+  return 0;
+}
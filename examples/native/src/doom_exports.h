@@ -2,6 +2,7 @@
 #ifndef DOOM_EXPORTS_H_
 #define DOOM_EXPORTS_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -32,6 +33,47 @@ doom_module_error_t *doom_module_error_new(const char *format, ...);
 // `doom_module_error_delete`
 void doom_module_error_delete(doom_module_error_t *error);
 
+////////////////////////////////////////////////////////////////
+//
+// doom_module_t
+//
+// Represents the Doom WebAssembly module, compiled and ready to be
+// instantiated any number of times.
+//
+////////////////////////////////////////////////////////////////
+
+typedef struct doom_module doom_module_t;
+
+// Loads (compiling, if needed) the Doom WebAssembly module.
+//
+// If `maxInstances` is greater than 0 then memory for that many instances is
+// set aside up front, and reused from one instance to the next, which makes
+// creating and deleting instances much cheaper. Creating an instance fails
+// while `maxInstances` instances of the module exist. A `maxInstances` of 0
+// means instances are allocated one by one, with no limit to how many there
+// are. A module built with threads must be loaded with a `maxInstances` of 0,
+// as each thread it spawns is an instance too. Where the underlying
+// interpreter can't set instances aside like that, `maxInstances` is ignored
+// (see `doom_module_pooled`).
+//
+// If loading the module is successful then NULL is returned and the caller
+// receives ownership of the produced `doom_module_t`. If there was an error
+// then a non-NULL error is returned, which the caller receives ownership of.
+doom_module_error_t *doom_module_new(const char *pathToWasmModule,
+                                     uint32_t maxInstances,
+                                     doom_module_t **out);
+
+// Whether the memory for instances of `module` is set aside up front and
+// reused, i.e. whether `module` was loaded with a `maxInstances` greater than 0,
+// by an interpreter that can do that.
+bool doom_module_pooled(doom_module_t *module);
+
+// Every instance created from `module` must be deleted before `module` is.
+//
+// If the module was built with threads, the threads its instances spawned are
+// still running, so the module isn't actually freed until they exit.
+void doom_module_delete(doom_module_t *module);
+
 ////////////////////////////////////////////////////////////////
 //
 // doom_module_instance_t
@@ -55,8 +97,28 @@ doom_module_error_t *doom_module_instance_new(const char *pathToWasmModule,
                                               doom_module_config_t *config,
                                               doom_module_instance_t **out);
 
+// Creates a new instance of an already loaded Doom WebAssembly module.
+//
+// It is the caller's responsibility to ensure that both the `module` and the
+// `config` provided will outlive the created `doom_module_instance_t`.
+//
+// Ownership of the result, or of any error, is the same as for
+// `doom_module_instance_new`.
+doom_module_error_t *
+doom_module_instance_new_from_module(doom_module_t *module,
+                                     doom_module_config_t *config,
+                                     doom_module_instance_t **out);
+
 void doom_module_instance_delete(doom_module_instance_t *instance);
 
+// Compiles the Doom WebAssembly module ahead of time, for this machine, and
+// saves the result so that later calls of `doom_module_instance_new`, with the
+// same module, don't have to compile it again.
+//
+// Returns NULL on success, otherwise an error which the caller receives
+// ownership of.
+doom_module_error_t *doom_module_precompile(const char *pathToWasmModule);
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // doom_module_context_t
@@ -75,6 +137,18 @@ doom_module_instance_context(doom_module_instance_t *instance);
 doom_module_config_t *
 doom_module_context_config(doom_module_context_t *context);
 
+// Attaches state of the host's own to an instance of the Doom WebAssembly
+// module, which the imports can then retrieve from the context they're passed.
+// This is what allows the same imports to serve more than one instance.
+//
+// The host state should be attached before `initGame` is called, and remains
+// owned by the caller, who must keep it alive as long as the instance is.
+void doom_module_context_set_host_state(doom_module_context_t *context,
+                                        void *hostState);
+
+// Returns NULL if no host state was attached.
+void *doom_module_context_host_state(doom_module_context_t *context);
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // memory_reference_t
@@ -92,8 +166,14 @@ typedef struct memory_reference memory_reference_t;
 // The returned `memory_reference_t` is only as long as the provided `context`
 // is valid, so instance of `memory_reference_t` should be used and then
 // relinquished quickly.
+//
+// Creating a `memory_reference_t` is cheap, it's fine to do on every call of
+// an import.
 memory_reference_t *memory_reference_new(doom_module_context_t *context);
 
+// The address of the start of the memory. This address can change whenever
+// the module runs (the memory may grow), so don't hold onto it across calls
+// into the module.
 uint8_t *memory_reference_data(memory_reference_t *ref);
 
 void memory_reference_delete(memory_reference_t *ref);
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+
+#include "doom_utils.h"
+
+// Provide implementations of all functions declared in doom_utils.h
+
+void write_i32_to_wasm_memory(uint8_t *address, int32_t val) {
+  uint32_t uVal = (uint32_t)val;
+  *(address + 0) = (uVal >> (8 * 0)) & 0xff;
+  *(address + 1) = (uVal >> (8 * 1)) & 0xff;
+  *(address + 2) = (uVal >> (8 * 2)) & 0xff;
+  *(address + 3) = (uVal >> (8 * 3)) & 0xff;
+}
+
+char *sprintf_with_malloc(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+
+  char *result = vsprintf_with_malloc(format, args);
+
+  va_end(args);
+
+  return result;
+}
+
+char *vsprintf_with_malloc(const char *format, va_list args) {
+  va_list args2;
+  va_copy(args2, args);
+
+  // +1 to account for the terminating \0 character
+  size_t charactersNeeded = 1 + vsnprintf(NULL, 0, format, args);
+  char *result = malloc(charactersNeeded);
+  vsprintf(result, format, args2);
+
+  va_end(args2);
+
+  return result;
+}
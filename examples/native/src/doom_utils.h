@@ -1,6 +1,7 @@
 #ifndef UTILS_H_
 #define UTILS_H_
 
+#include <stdarg.h>
 #include <stdint.h>
 
 #define ARRAY_LENGTH(array) (sizeof(array) / sizeof(*array))
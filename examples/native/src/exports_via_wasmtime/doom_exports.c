@@ -1,10 +1,15 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wasm.h>
 #include <wasmtime.h>
 #include <stdarg.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <doom_imports.h>
 #include <doom_exports.h>
@@ -17,14 +22,7 @@
   in doom_exports.h
 */
 
-struct doom_module_instance {
-  doom_module_context_t *context;
-  wasm_engine_t *engine;
-  wasmtime_linker_t *linker;
-  wasmtime_store_t *store;
-  wasmtime_module_t *module;
-  wasmtime_instance_t instance;
-};
+typedef struct thread_spawner thread_spawner_t;
 
 // Define a function type which generically allows the retrieval, by name, of an
 // item exported from a module.
@@ -52,11 +50,78 @@ typedef bool export_getter(void *env, wasmtime_context_t *context,
                            const char *name, size_t name_len,
                            wasmtime_extern_t *item);
 
+// The exports used over and over again while Doom runs, retrieved once per
+// store (i.e. once per instance, and once per thread for a module built with
+// threads) rather than by name each time they're used.
+typedef struct cached_exports {
+  bool resolved;
+  wasmtime_extern_t initGame;
+  wasmtime_extern_t tickGame;
+  wasmtime_extern_t reportKeyDown;
+  wasmtime_extern_t reportKeyUp;
+  wasmtime_extern_t memory;
+  // The base address of `memory`, which only changes when `memory` grows, and
+  // so is only read again when the size of `memory` differs from `memorySize`.
+  uint8_t *memoryData;
+  size_t memorySize;
+  // Set via the `DOOM_CHECKED_CALLS` env variable, to call exports via
+  // `wasmtime_func_call` instead, e.g. to compare the cost of calling them
+  bool checkedCalls;
+} cached_exports_t;
+
+struct memory_reference {
+  cached_exports_t *exports;
+  wasmtime_context_t *wasm_context;
+};
+
 struct doom_module_context {
   doom_module_config_t *config;
+  struct store_data *storeData;
   wasmtime_context_t *wasm_context;
   void *env_for_export_get;
   export_getter *export_get;
+  cached_exports_t *exports;
+  // Handed out by `memory_reference_new`, so no allocation is needed
+  memory_reference_t memory;
+};
+
+// The data attached to each Wasmtime store, which is how an import, called
+// with nothing but the store, finds the config and exports of the instance
+// that called it.
+typedef struct store_data {
+  doom_module_config_t *config;
+  // Set via `doom_module_context_set_host_state`
+  void *hostState;
+  cached_exports_t exports;
+} store_data_t;
+
+struct doom_module {
+  wasm_engine_t *engine;
+  wasmtime_module_t *module;
+  // Has all of Doom's imports defined, and is shared by every instance of the
+  // module, unless the module was built with threads
+  wasmtime_linker_t *linker;
+  bool builtWithThreads;
+  bool pooled;
+  // Held by the caller of `doom_module_new`, and by each `thread_spawner_t`,
+  // as the threads it spawns use the engine and module for as long as they
+  // run, which may be after the instance that spawned them is deleted
+  atomic_int references;
+};
+
+struct doom_module_instance {
+  doom_module_context_t *context;
+  doom_module_t *module;
+  // Only non-NULL when the instance was created via `doom_module_instance_new`
+  // and so has a `doom_module_t` all to itself
+  doom_module_t *ownedModule;
+  wasmtime_store_t *store;
+  wasmtime_instance_t instance;
+  store_data_t storeData;
+  // Only non-NULL when the module was built with threads, in which case the
+  // instance also has a linker of its own, which defines its shared memory
+  thread_spawner_t *spawner;
+  wasmtime_linker_t *linker;
 };
 
 // Implementation of `export_getter` for when the export is retrieved via a
@@ -187,6 +252,94 @@ static doom_module_error_t *retrieve_export(doom_module_context_t *context,
   }
 }
 
+// Retrieves, and checks the type of, each of the exports in
+// `context->exports`, so that afterwards they can be used without being looked
+// up by name and without their arguments being type-checked on each call.
+static doom_module_error_t *
+cached_exports_resolve(doom_module_context_t *context) {
+  cached_exports_t *exports = context->exports;
+  doom_module_error_t *error = NULL;
+
+  struct {
+    const char *name;
+    wasmtime_extern_t *item;
+    size_t numParams;
+  } funcs[] = {
+      {"initGame", &exports->initGame, 0},
+      {"tickGame", &exports->tickGame, 0},
+      {"reportKeyDown", &exports->reportKeyDown, 1},
+      {"reportKeyUp", &exports->reportKeyUp, 1},
+  };
+
+  int numRetrieved = 0;
+  for (; numRetrieved < ARRAY_LENGTH(funcs); numRetrieved++) {
+    int i = numRetrieved;
+    error = retrieve_export(context, funcs[i].name, WASMTIME_EXTERN_FUNC,
+                            funcs[i].item);
+    if (error) {
+      break;
+    }
+
+    // Calls made via `wasmtime_func_call_unchecked` trust that the arguments
+    // match the function's type, so that's checked here, once.
+    wasm_functype_t *type =
+        wasmtime_func_type(context->wasm_context, &funcs[i].item->of.func);
+    const wasm_valtype_vec_t *params = wasm_functype_params(type);
+    const wasm_valtype_vec_t *results = wasm_functype_results(type);
+    bool ok = params->size == funcs[i].numParams && results->size == 0;
+    for (size_t j = 0; ok && j < params->size; j++) {
+      ok = wasm_valtype_kind(params->data[j]) == WASM_I32;
+    }
+    wasm_functype_delete(type);
+    if (!ok) {
+      error = doom_module_error_new(
+          "Export `%s` did not have the expected function type", funcs[i].name);
+      wasmtime_extern_delete(funcs[i].item);
+      break;
+    }
+  }
+
+  // The exported memory is a shared memory when the module was built with
+  // threads, and a regular memory otherwise.
+  const char *name = "memory";
+  if (!error &&
+      !context->export_get(context->env_for_export_get, context->wasm_context,
+                           name, strlen(name), &exports->memory)) {
+    error = doom_module_error_new("Failed to retrieve the export `%s`", name);
+  } else if (!error && exports->memory.kind != WASMTIME_EXTERN_MEMORY &&
+             exports->memory.kind != WASMTIME_EXTERN_SHAREDMEMORY) {
+    error = doom_module_error_new(
+        "Export `%s` had the type `%" PRIu8 "` instead of a memory type", name,
+        exports->memory.kind);
+    wasmtime_extern_delete(&exports->memory);
+  }
+
+  if (error) {
+    for (int i = 0; i < numRetrieved; i++) {
+      wasmtime_extern_delete(funcs[i].item);
+    }
+    return error;
+  }
+
+  exports->memoryData = NULL;
+  exports->memorySize = 0;
+  exports->checkedCalls = getenv("DOOM_CHECKED_CALLS") != NULL;
+
+  exports->resolved = true;
+  return NULL;
+}
+
+static void cached_exports_release(cached_exports_t *exports) {
+  if (exports->resolved) {
+    wasmtime_extern_delete(&exports->initGame);
+    wasmtime_extern_delete(&exports->tickGame);
+    wasmtime_extern_delete(&exports->reportKeyDown);
+    wasmtime_extern_delete(&exports->reportKeyUp);
+    wasmtime_extern_delete(&exports->memory);
+    exports->resolved = false;
+  }
+}
+
 doom_module_config_t *
 doom_module_context_config(doom_module_context_t *context) {
   return context->config;
@@ -197,12 +350,20 @@ doom_module_instance_context(doom_module_instance_t *instance) {
   return instance->context;
 }
 
+void doom_module_context_set_host_state(doom_module_context_t *context,
+                                        void *hostState) {
+  context->storeData->hostState = hostState;
+}
+
+void *doom_module_context_host_state(doom_module_context_t *context) {
+  return context->storeData->hostState;
+}
+
 // Define the data that's stored along with each registered import.
 // This data provides exactly what's needed to call an implementation of that
 // import.
 typedef struct registered_import_env {
   wrapped_func_t *wrapped_import_impl;
-  doom_module_config_t *config;
 } registered_import_env_t;
 
 // Generic callback that handles the calling of all imported functions.
@@ -212,15 +373,33 @@ call_wrapped_func_stored_in_env(void *env, wasmtime_caller_t *caller,
                                 const wasmtime_val_t *args, size_t nargs,
                                 wasmtime_val_t *results, size_t nresults) {
   registered_import_env_t *rie = (registered_import_env_t *)env;
+  wasmtime_context_t *wasm_context = wasmtime_caller_context(caller);
+  store_data_t *storeData =
+      (store_data_t *)wasmtime_context_get_data(wasm_context);
 
   // Set up the needed "context" (i.e.
   // `doom_module_context_t`) to pass to the imported function as it's
   // called.
   doom_module_context_t context;
-  context.config = rie->config;
-  context.wasm_context = wasmtime_caller_context(caller);
+  context.config = storeData->config;
+  context.storeData = storeData;
+  context.wasm_context = wasm_context;
   context.env_for_export_get = caller;
   context.export_get = export_get_via_wasmtime_caller;
+  context.exports = &storeData->exports;
+  context.memory.exports = &storeData->exports;
+  context.memory.wasm_context = wasm_context;
+
+  // The exports are retrieved by the first import called in each store
+  if (!storeData->exports.resolved) {
+    doom_module_error_t *error = cached_exports_resolve(&context);
+    if (error) {
+      wasm_trap_t *trap = wasmtime_trap_new(error->message,
+                                            strlen(error->message));
+      doom_module_error_delete(error);
+      return trap;
+    }
+  }
 
   return wrapped_func_call(rie->wrapped_import_impl, &context, args, nargs,
                            results, nresults);
@@ -236,8 +415,7 @@ static void delete_wrapped_func_stored_in_env(void *env) {
 // A utility for registering all imports needed by Doom, which are all declared
 // in `doom_imports.h`, to a provided linker.
 static wasmtime_error_t *
-register_all_needed_imports(wasmtime_linker_t *linker,
-                            doom_module_config_t *config) {
+register_all_needed_imports(wasmtime_linker_t *linker) {
   struct {
     const char *module;
     const char *name;
@@ -269,7 +447,6 @@ register_all_needed_imports(wasmtime_linker_t *linker,
     const char *name = imported_funcs[i].name;
     registered_import_env_t *rie = malloc(sizeof(registered_import_env_t));
     rie->wrapped_import_impl = imported_funcs[i].wrapped_import_impl;
-    rie->config = config;
 
     wasmtime_error_t *error = wasmtime_linker_define_func(
         linker, module, strlen(module), name, strlen(name),
@@ -285,84 +462,707 @@ register_all_needed_imports(wasmtime_linker_t *linker,
   return NULL;
 }
 
-// Creates a new `doom_module_instance_t`.
-doom_module_error_t *doom_module_instance_new(const char *pathToWasmModule,
-                                              doom_module_config_t *config,
-                                              doom_module_instance_t **out) {
+// Support for a Doom WebAssembly module built with threads (e.g. via `make
+// THREADS=4`), following the wasi-threads proposal:
+// https://github.com/WebAssembly/wasi-threads
+//
+// Such a module differs from the usual one in two ways:
+//  1. It imports its `memory`, which is a shared memory, rather than defining
+//     its own (it still re-exports that memory under the name `memory`).
+//  2. It imports `wasi.thread-spawn`, which is expected to start a new thread
+//     running a fresh instance of the same module, against the same shared
+//     memory, by calling that instance's `wasi_thread_start` export.
+//
+// Wasmtime stores can't be shared across threads, so each spawned thread gets
+// its own store, linker, and instance, all created from the one engine and
+// module that are shared by every thread.
+//
+// Threads are never joined: Doom's threads wait for work until the process
+// exits. So the spawner (and with it the shared memory, engine, and module) is
+// only freed once the instance that created it, and every thread it spawned,
+// have released it.
+struct thread_spawner {
+  doom_module_t *doomModule;
+  wasm_engine_t *engine;
+  wasmtime_module_t *module;
+  doom_module_config_t *config;
+  wasmtime_sharedmemory_t *memory;
+  char *memoryImportModule;
+  char *memoryImportName;
+  atomic_int nextThreadId;
+  // Held by the instance that created the spawner, and by each spawned thread
+  atomic_int references;
+};
 
-  doom_module_context_t *context = malloc(sizeof(doom_module_context_t));
-  // Initialize entire context to 0
-  *context = (doom_module_context_t){0};
+typedef struct spawned_thread {
+  thread_spawner_t *spawner;
+  int32_t threadId;
+  int32_t startArg;
+  // The host state of the instance that spawned the thread
+  void *hostState;
+} spawned_thread_t;
 
-  doom_module_instance_t *doom_instance =
-      malloc(sizeof(doom_module_instance_t));
-  // Initialize entire instance to 0
-  *doom_instance = (doom_module_instance_t){0};
-  doom_instance->context = context;
+static wasmtime_error_t *
+define_threading_imports(wasmtime_linker_t *linker,
+                         wasmtime_context_t *wasm_context,
+                         thread_spawner_t *spawner);
+
+static void thread_spawner_release(thread_spawner_t *spawner);
+
+static void *run_spawned_thread(void *arg) {
+  spawned_thread_t *thread = (spawned_thread_t *)arg;
+  thread_spawner_t *spawner = thread->spawner;
+
+  // The exports of this thread's instance are filled in by the first import
+  // the thread calls
+  store_data_t storeData = {0};
+  storeData.config = spawner->config;
+  storeData.hostState = thread->hostState;
+
+  wasmtime_store_t *store =
+      wasmtime_store_new(spawner->engine, &storeData, NULL);
+  wasmtime_linker_t *linker = wasmtime_linker_new(spawner->engine);
+  wasmtime_context_t *wasm_context = wasmtime_store_context(store);
+
+  doom_module_error_t *error = NULL;
+  wasmtime_error_t *wasmtime_error = register_all_needed_imports(linker);
+  if (wasmtime_error == NULL) {
+    wasmtime_error = define_threading_imports(linker, wasm_context, spawner);
+  }
 
-  // Create the WASM engine, linker, and store we'll need to instantiate and
-  // interact with the WebAssembly module.
-  printf("Initializing core WebAssembly environment...\n");
-  doom_instance->engine = wasm_engine_new();
-  if (doom_instance->engine == NULL) {
-    doom_module_instance_delete(doom_instance);
-    return doom_module_error_new("Failed to create WASM engine");
+  wasm_trap_t *trap = NULL;
+  wasmtime_instance_t instance;
+  if (wasmtime_error == NULL) {
+    wasmtime_error = wasmtime_linker_instantiate(
+        linker, wasm_context, spawner->module, &instance, &trap);
   }
-  doom_instance->linker = wasmtime_linker_new(doom_instance->engine);
-  doom_instance->store = wasmtime_store_new(doom_instance->engine, NULL, NULL);
-  if (doom_instance->linker == NULL || doom_instance->store == NULL) {
-    doom_module_instance_delete(doom_instance);
-    return doom_module_error_new("Failed to create WASM linker or store");
+
+  if (wasmtime_error != NULL || trap != NULL) {
+    error = doom_module_error_new_with_context(
+        wasmtime_error, trap,
+        doom_module_error_new("Failed to instantiate module for thread %d",
+                              thread->threadId));
+  } else {
+    const char *name = "wasi_thread_start";
+    wasmtime_extern_t threadStart;
+    if (!wasmtime_instance_export_get(wasm_context, &instance, name,
+                                      strlen(name), &threadStart) ||
+        threadStart.kind != WASMTIME_EXTERN_FUNC) {
+      error = doom_module_error_new("Failed to retrieve the export `%s`", name);
+    } else {
+      wasmtime_val_t params[2];
+      params[0].kind = WASMTIME_I32;
+      params[0].of.i32 = thread->threadId;
+      params[1].kind = WASMTIME_I32;
+      params[1].of.i32 = thread->startArg;
+
+      wasmtime_error =
+          wasmtime_func_call(wasm_context, &threadStart.of.func, params,
+                             ARRAY_LENGTH(params), NULL, 0, &trap);
+      wasmtime_extern_delete(&threadStart);
+      if (wasmtime_error != NULL || trap != NULL) {
+        error = doom_module_error_new_with_context(
+            wasmtime_error, trap,
+            doom_module_error_new("Error while running thread %d",
+                                  thread->threadId));
+      }
+    }
   }
 
-  // Read the Doom WebAssembly module from disk
+  if (error) {
+    fprintf(stderr, "An error occurred!\n%s\n", error->message);
+    doom_module_error_delete(error);
+  }
+
+  cached_exports_release(&storeData.exports);
+  wasmtime_linker_delete(linker);
+  wasmtime_store_delete(store);
+  thread_spawner_release(spawner);
+  free(thread);
+  return NULL;
+}
+
+// Implementation of the import `wasi.thread-spawn(i32) -> (i32)`, which
+// returns the (positive) id of the new thread, or a negative value on failure.
+// This function matches the signature defined by `wasmtime_func_callback_t`.
+static wasm_trap_t *thread_spawn(void *env, wasmtime_caller_t *caller,
+                                 const wasmtime_val_t *args, size_t nargs,
+                                 wasmtime_val_t *results, size_t nresults) {
+  thread_spawner_t *spawner = (thread_spawner_t *)env;
+
+  spawned_thread_t *thread = malloc(sizeof(spawned_thread_t));
+  thread->spawner = spawner;
+  thread->threadId = atomic_fetch_add(&spawner->nextThreadId, 1);
+  thread->startArg = args[0].of.i32;
+  wasmtime_context_t *wasm_context = wasmtime_caller_context(caller);
+  store_data_t *storeData =
+      (store_data_t *)wasmtime_context_get_data(wasm_context);
+  thread->hostState = storeData->hostState;
+
+  results[0].kind = WASMTIME_I32;
+  results[0].of.i32 = thread->threadId;
+
+  // Released by the thread once it's done
+  atomic_fetch_add(&spawner->references, 1);
+
+  pthread_t nativeThread;
+  if (pthread_create(&nativeThread, NULL, run_spawned_thread, thread) != 0) {
+    thread_spawner_release(spawner);
+    free(thread);
+    results[0].of.i32 = -1;
+  } else {
+    pthread_detach(nativeThread);
+  }
+
+  return NULL;
+}
+
+static wasmtime_error_t *
+define_threading_imports(wasmtime_linker_t *linker,
+                         wasmtime_context_t *wasm_context,
+                         thread_spawner_t *spawner) {
+  wasmtime_extern_t memory;
+  memory.kind = WASMTIME_EXTERN_SHAREDMEMORY;
+  memory.of.sharedmemory = spawner->memory;
+  wasmtime_error_t *error = wasmtime_linker_define(
+      linker, wasm_context, spawner->memoryImportModule,
+      strlen(spawner->memoryImportModule), spawner->memoryImportName,
+      strlen(spawner->memoryImportName), &memory);
+  if (error != NULL) {
+    return error;
+  }
+
+  const char *module = "wasi";
+  const char *name = "thread-spawn";
+  wasm_functype_t *type =
+      wasm_functype_new_1_1(wasm_valtype_new_i32(), wasm_valtype_new_i32());
+  error = wasmtime_linker_define_func(linker, module, strlen(module), name,
+                                      strlen(name), type, thread_spawn, spawner,
+                                      NULL);
+  wasm_functype_delete(type);
+  return error;
+}
+
+static void doom_module_release(doom_module_t *module);
+
+static void thread_spawner_release(thread_spawner_t *spawner) {
+  if (atomic_fetch_sub(&spawner->references, 1) != 1) {
+    return;
+  }
+
+  wasmtime_sharedmemory_delete(spawner->memory);
+  free(spawner->memoryImportModule);
+  free(spawner->memoryImportName);
+  doom_module_release(spawner->doomModule);
+  free(spawner);
+}
+
+// Creates a `thread_spawner_t`, and the shared memory it hands to every
+// thread, if `doomModule` was built with threads (i.e. it imports a memory).
+// Otherwise `*out` is left as NULL.
+static wasmtime_error_t *thread_spawner_new(doom_module_t *doomModule,
+                                            doom_module_config_t *config,
+                                            thread_spawner_t **out) {
+  wasm_engine_t *engine = doomModule->engine;
+  wasmtime_module_t *module = doomModule->module;
+  wasmtime_error_t *error = NULL;
+  *out = NULL;
+
+  wasm_importtype_vec_t imports;
+  wasmtime_module_imports(module, &imports);
+
+  for (size_t i = 0; i < imports.size; i++) {
+    const wasm_externtype_t *type = wasm_importtype_type(imports.data[i]);
+    if (wasm_externtype_kind(type) != WASM_EXTERN_MEMORY) {
+      continue;
+    }
+
+    wasmtime_sharedmemory_t *memory = NULL;
+    error = wasmtime_sharedmemory_new(
+        engine, wasm_externtype_as_memorytype_const(type), &memory);
+    if (error != NULL) {
+      break;
+    }
+
+    const wasm_name_t *moduleName = wasm_importtype_module(imports.data[i]);
+    const wasm_name_t *name = wasm_importtype_name(imports.data[i]);
+
+    thread_spawner_t *spawner = malloc(sizeof(thread_spawner_t));
+    spawner->doomModule = doomModule;
+    atomic_fetch_add(&doomModule->references, 1);
+    spawner->engine = engine;
+    spawner->module = module;
+    spawner->config = config;
+    spawner->memory = memory;
+    spawner->memoryImportModule = sprintf_with_malloc(
+        "%.*s", (int)moduleName->size, moduleName->data);
+    spawner->memoryImportName =
+        sprintf_with_malloc("%.*s", (int)name->size, name->data);
+    // Thread id 0 is never handed out, as it would be mistaken for the main
+    // thread
+    atomic_init(&spawner->nextThreadId, 1);
+    atomic_init(&spawner->references, 1);
+
+    *out = spawner;
+    break;
+  }
+
+  wasm_importtype_vec_delete(&imports);
+  return error;
+}
+
+// Compiled modules are cached in this folder, within the user's cache folder
+// (`$XDG_CACHE_HOME`, or else `~/.cache`), keyed by a hash of the bytes of the
+// WebAssembly module they were compiled from.
+#define MODULE_CACHE_FOLDER_NAME "doom.wasm"
+
+// Wasmtime's C API only has the pooling allocator from Wasmtime 23 on, so
+// when built against an older Wasmtime (such as 21, which conanfile.txt pins)
+// instances are always allocated one by one
+#if WASMTIME_VERSION_MAJOR >= 23
+#define POOLING_ALLOCATOR_AVAILABLE 1
+#else
+#define POOLING_ALLOCATOR_AVAILABLE 0
+#endif
+
+// The most memory any one pooled instance may grow its memory to, which is
+// plenty for Doom and a few large WADs. Only address space is reserved up
+// front, pages are only committed as they're used.
+#define POOLED_INSTANCE_MAX_MEMORY_SIZE ((size_t)512 << 20)
+
+// Every engine is created with the same configuration, which a module loaded
+// from the cache must have been compiled with. Only how instances are
+// allocated differs, which doesn't affect compiled code.
+static wasm_engine_t *engine_new(uint32_t maxInstances) {
+  wasm_config_t *engine_config = wasm_config_new();
+  // Needed to run a Doom WebAssembly module that was built with threads
+  wasmtime_config_wasm_threads_set(engine_config, true);
+  // Initialize each instance's memory by mapping, copy-on-write, an image of
+  // the module's data segments (which include the embedded Doom shareware
+  // WAD), rather than copying the segments into memory.
+  wasmtime_config_memory_init_cow_set(engine_config, true);
+
+#if POOLING_ALLOCATOR_AVAILABLE
+  if (maxInstances > 0) {
+    // Take each instance, memory, and table from slots reserved up front for
+    // `maxInstances` instances, which are reset, rather than freed, when an
+    // instance is deleted, so creating an instance allocates nothing.
+    wasmtime_pooling_allocation_config_t *pooling =
+        wasmtime_pooling_allocation_config_new();
+    wasmtime_pooling_allocation_config_total_core_instances_set(pooling,
+                                                                maxInstances);
+    wasmtime_pooling_allocation_config_total_memories_set(pooling,
+                                                          maxInstances);
+    wasmtime_pooling_allocation_config_total_tables_set(pooling, maxInstances);
+    wasmtime_pooling_allocation_config_max_memory_size_set(
+        pooling, POOLED_INSTANCE_MAX_MEMORY_SIZE);
+    wasmtime_config_pooling_allocation_strategy_set(engine_config, pooling);
+    wasmtime_pooling_allocation_config_delete(pooling);
+  }
+#endif
+
+  return wasm_engine_new_with_config(engine_config);
+}
+
+// Reads the Doom WebAssembly module from disk.
+//
+// Upon success, caller receives ownership of `out`.
+static doom_module_error_t *read_module_file(const char *pathToWasmModule,
+                                             wasm_byte_vec_t *out) {
   FILE *file = fopen(pathToWasmModule, "rb");
   if (file == NULL) {
-    doom_module_instance_delete(doom_instance);
     return doom_module_error_new("Failed to open Doom WebAssembly module file");
   }
   fseek(file, 0L, SEEK_END);
   size_t file_size = ftell(file);
   fseek(file, 0L, SEEK_SET);
-  wasm_byte_vec_t wasm;
-  wasm_byte_vec_new_uninitialized(&wasm, file_size);
-  size_t objectsRead = fread(wasm.data, file_size, 1, file);
+  wasm_byte_vec_new_uninitialized(out, file_size);
+  size_t objectsRead = fread(out->data, file_size, 1, file);
   fclose(file);
   if (objectsRead != 1) {
-    wasm_byte_vec_delete(&wasm);
-    doom_module_instance_delete(doom_instance);
+    wasm_byte_vec_delete(out);
     return doom_module_error_new(
         "Error reading Doom WebAssembly module from disk");
   }
+  return NULL;
+}
+
+// Creates the folder at `path`, and any folders it's in that don't exist yet,
+// readable and writable by the current user alone. Failing to do so isn't an
+// error here, what's at `path` is checked afterwards.
+static void make_private_folders(char *path) {
+  for (char *slash = strchr(path + 1, '/'); slash != NULL;
+       slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    mkdir(path, 0700);
+    *slash = '/';
+  }
+  mkdir(path, 0700);
+}
+
+// The folder compiled modules are cached in, which is created if need be, or
+// NULL if there's no folder that can safely be used.
+//
+// Loading a compiled module runs the native code in it, so the folder is only
+// used if it's a folder (not a link to one) that belongs to the current user,
+// and that no one else can write to.
+//
+// The returned `char *` is owned by the caller.
+static char *module_cache_folder(void) {
+  const char *xdgCacheHome = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  char *cacheHome = NULL;
+  // Per the XDG Base Directory Specification, a relative path is ignored
+  if (xdgCacheHome != NULL && xdgCacheHome[0] == '/') {
+    cacheHome = sprintf_with_malloc("%s", xdgCacheHome);
+  } else if (home != NULL && home[0] == '/') {
+    cacheHome = sprintf_with_malloc("%s/.cache", home);
+  } else {
+    return NULL;
+  }
+  char *folder = sprintf_with_malloc("%s/" MODULE_CACHE_FOLDER_NAME, cacheHome);
+  free(cacheHome);
+  make_private_folders(folder);
+
+  struct stat info;
+  if (lstat(folder, &info) != 0 || !S_ISDIR(info.st_mode) ||
+      info.st_uid != getuid() || (info.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+    fprintf(stderr, "Not caching compiled modules in '%s'\n", folder);
+    free(folder);
+    return NULL;
+  }
+  return folder;
+}
+
+// The path, in the module cache, of the compiled form of `wasm`, or NULL if
+// there's no module cache.
+//
+// The key is only a hash of `wasm`, not of the engine's configuration (see
+// engine_new) or Wasmtime's version. That's only correct because Wasmtime
+// refuses to load a compiled module that doesn't match either, which then
+// gets compiled (and cached) again.
+//
+// The returned `char *` is owned by the caller.
+static char *module_cache_path(const wasm_byte_vec_t *wasm) {
+  char *folder = module_cache_folder();
+  if (folder == NULL) {
+    return NULL;
+  }
+
+  // 64-bit FNV-1a
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < wasm->size; i++) {
+    hash ^= (uint8_t)wasm->data[i];
+    hash *= 0x100000001b3;
+  }
+  char *path =
+      sprintf_with_malloc("%s/doom-%016" PRIx64 ".cwasm", folder, hash);
+  free(folder);
+  return path;
+}
+
+// Writes a compiled module to the module cache. Failing to do so isn't an
+// error, the module will just be compiled again next time.
+static void module_cache_store(wasmtime_module_t *module, const char *path) {
+  wasm_byte_vec_t serialized;
+  wasmtime_error_t *error = wasmtime_module_serialize(module, &serialized);
+  if (error != NULL) {
+    wasmtime_error_delete(error);
+    return;
+  }
+
+  // The file is written under another name and then renamed into place, so
+  // that another process starting at the same time never loads half of it.
+  char *tempPath = sprintf_with_malloc("%s.%d.tmp", path, (int)getpid());
+  FILE *file = fopen(tempPath, "wb");
+  bool ok = file != NULL &&
+            fwrite(serialized.data, serialized.size, 1, file) == 1;
+  if (file != NULL) {
+    ok = fclose(file) == 0 && ok;
+  }
+  ok = ok && rename(tempPath, path) == 0;
+  if (!ok) {
+    remove(tempPath);
+    fprintf(stderr, "Failed to write compiled module to '%s'\n", path);
+  }
+
+  free(tempPath);
+  wasm_byte_vec_delete(&serialized);
+}
+
+// Compiles `wasm` into a module, unless it's been compiled before, in which
+// case the compiled module is loaded from the module cache instead.
+//
+// Whatever is in the module cache is trusted to be a module compiled and
+// written by this code, which is why the cache lives in a folder only the
+// current user can write to (see module_cache_folder).
+static wasmtime_error_t *module_new_with_cache(wasm_engine_t *engine,
+                                               const wasm_byte_vec_t *wasm,
+                                               wasmtime_module_t **out) {
+  char *path = module_cache_path(wasm);
+
+  wasmtime_error_t *error = NULL;
+  if (path != NULL) {
+    error = wasmtime_module_deserialize_file(engine, path, out);
+    if (error == NULL) {
+      printf("Loaded compiled WebAssembly module from '%s'...\n", path);
+      free(path);
+      return NULL;
+    }
+    wasmtime_error_delete(error);
+  }
 
   printf("Compiling WebAssembly module...\n");
-  wasmtime_error_t *error =
-      wasmtime_module_new(doom_instance->engine, (uint8_t *)wasm.data,
-                          wasm.size, &doom_instance->module);
+  error = wasmtime_module_new(engine, (uint8_t *)wasm->data, wasm->size, out);
+  if (error == NULL && path != NULL) {
+    module_cache_store(*out, path);
+  }
+
+  free(path);
+  return error;
+}
+
+doom_module_error_t *doom_module_precompile(const char *pathToWasmModule) {
+  wasm_engine_t *engine = engine_new(0);
+  if (engine == NULL) {
+    return doom_module_error_new("Failed to create WASM engine");
+  }
+
+  wasm_byte_vec_t wasm;
+  doom_module_error_t *error = read_module_file(pathToWasmModule, &wasm);
+  if (error == NULL) {
+    wasmtime_module_t *module = NULL;
+    wasmtime_error_t *wasmtime_error =
+        module_new_with_cache(engine, &wasm, &module);
+    wasm_byte_vec_delete(&wasm);
+    if (wasmtime_error != NULL) {
+      error = doom_module_error_new_with_context(
+          wasmtime_error, NULL,
+          doom_module_error_new("Failed to compile module"));
+    } else {
+      wasmtime_module_delete(module);
+    }
+  }
+
+  wasm_engine_delete(engine);
+  return error;
+}
+
+// Checks that `module` has all the exports expected of Doom, and whether it was
+// built with threads (i.e. imports its memory).
+static doom_module_error_t *check_module(wasmtime_module_t *module,
+                                         bool *builtWithThreads) {
+  *builtWithThreads = false;
+  wasm_importtype_vec_t imports;
+  wasmtime_module_imports(module, &imports);
+  for (size_t i = 0; i < imports.size; i++) {
+    const wasm_externtype_t *type = wasm_importtype_type(imports.data[i]);
+    if (wasm_externtype_kind(type) == WASM_EXTERN_MEMORY) {
+      *builtWithThreads = true;
+    }
+  }
+  wasm_importtype_vec_delete(&imports);
+
+  struct {
+    const char *name;
+    wasm_externkind_t kind;
+  } requiredExports[] = {
+      {"initGame", WASM_EXTERN_FUNC},
+      {"tickGame", WASM_EXTERN_FUNC},
+      {"reportKeyDown", WASM_EXTERN_FUNC},
+      {"reportKeyUp", WASM_EXTERN_FUNC},
+      {"memory", WASM_EXTERN_MEMORY},
+      {"KEY_ALT", WASM_EXTERN_GLOBAL},
+      {"KEY_BACKSPACE", WASM_EXTERN_GLOBAL},
+      {"KEY_DOWNARROW", WASM_EXTERN_GLOBAL},
+      {"KEY_ENTER", WASM_EXTERN_GLOBAL},
+      {"KEY_ESCAPE", WASM_EXTERN_GLOBAL},
+      {"KEY_FIRE", WASM_EXTERN_GLOBAL},
+      {"KEY_LEFTARROW", WASM_EXTERN_GLOBAL},
+      {"KEY_RIGHTARROW", WASM_EXTERN_GLOBAL},
+      {"KEY_SHIFT", WASM_EXTERN_GLOBAL},
+      {"KEY_STRAFE_L", WASM_EXTERN_GLOBAL},
+      {"KEY_STRAFE_R", WASM_EXTERN_GLOBAL},
+      {"KEY_TAB", WASM_EXTERN_GLOBAL},
+      {"KEY_UPARROW", WASM_EXTERN_GLOBAL},
+      {"KEY_USE", WASM_EXTERN_GLOBAL},
+  };
+
+  wasm_exporttype_vec_t exports;
+  wasmtime_module_exports(module, &exports);
+
+  doom_module_error_t *error = NULL;
+  for (int i = 0; !error && i < ARRAY_LENGTH(requiredExports); i++) {
+    const char *name = requiredExports[i].name;
+    const wasm_externtype_t *type = NULL;
+    for (size_t j = 0; j < exports.size; j++) {
+      const wasm_name_t *exportName = wasm_exporttype_name(exports.data[j]);
+      if (exportName->size == strlen(name) &&
+          memcmp(exportName->data, name, exportName->size) == 0) {
+        type = wasm_exporttype_type(exports.data[j]);
+        break;
+      }
+    }
+
+    if (type == NULL) {
+      error = doom_module_error_new("Module is missing the export `%s`", name);
+    } else if (wasm_externtype_kind(type) != requiredExports[i].kind) {
+      error = doom_module_error_new(
+          "Export `%s` had the type `%" PRIu8
+          "` instead of the expected type, `%" PRIu8 "`",
+          name, wasm_externtype_kind(type), requiredExports[i].kind);
+    }
+  }
+
+  wasm_exporttype_vec_delete(&exports);
+  return error;
+}
+
+doom_module_error_t *doom_module_new(const char *pathToWasmModule,
+                                     uint32_t maxInstances,
+                                     doom_module_t **out) {
+  doom_module_t *doom_module = malloc(sizeof(doom_module_t));
+  // Initialize entire module to 0
+  *doom_module = (doom_module_t){0};
+  atomic_init(&doom_module->references, 1);
+
+  // Create the WASM engine and linker we'll need to instantiate the WebAssembly
+  // module.
+  printf("Initializing core WebAssembly environment...\n");
+  doom_module->engine = engine_new(maxInstances);
+  doom_module->pooled = POOLING_ALLOCATOR_AVAILABLE && maxInstances > 0;
+  if (doom_module->engine == NULL) {
+    doom_module_delete(doom_module);
+    return doom_module_error_new("Failed to create WASM engine");
+  }
+
+  // Read the Doom WebAssembly module from disk
+  wasm_byte_vec_t wasm;
+  doom_module_error_t *read_error = read_module_file(pathToWasmModule, &wasm);
+  if (read_error != NULL) {
+    doom_module_delete(doom_module);
+    return read_error;
+  }
+
+  wasmtime_error_t *error = module_new_with_cache(doom_module->engine, &wasm,
+                                                  &doom_module->module);
   wasm_byte_vec_delete(&wasm);
   if (error != NULL) {
-    doom_module_instance_delete(doom_instance);
+    doom_module_delete(doom_module);
     doom_module_error_t *context =
         doom_module_error_new("Failed to compile module");
     return doom_module_error_new_with_context(error, NULL, context);
   }
 
-  printf("Registering all needed imports with the linker...\n");
-  error = register_all_needed_imports(doom_instance->linker, config);
-  if (error != NULL) {
-    doom_module_instance_delete(doom_instance);
-    doom_module_error_t *context =
-        doom_module_error_new("Failed to register all imports to linker");
-    return doom_module_error_new_with_context(error, NULL, context);
+  doom_module_error_t *check_error =
+      check_module(doom_module->module, &doom_module->builtWithThreads);
+  if (check_error != NULL) {
+    doom_module_delete(doom_module);
+    return check_error;
   }
 
-  printf("Instantiating module...\n");
-  wasm_trap_t *trap = NULL;
+  // Every thread a module built with threads spawns is an instance of its own,
+  // which would take a slot set aside for `maxInstances` instances, and keep
+  // it for as long as the thread runs (i.e. until the process exits)
+  if (doom_module->pooled && doom_module->builtWithThreads) {
+    doom_module_delete(doom_module);
+    return doom_module_error_new(
+        "Instances of a module built with threads can't be pooled, "
+        "`maxInstances` must be 0");
+  }
+
+  // A module built with threads needs a linker per instance, as each instance
+  // has its own shared memory
+  if (!doom_module->builtWithThreads) {
+    printf("Registering all needed imports with the linker...\n");
+    doom_module->linker = wasmtime_linker_new(doom_module->engine);
+    error = register_all_needed_imports(doom_module->linker);
+    if (error != NULL) {
+      doom_module_delete(doom_module);
+      doom_module_error_t *context =
+          doom_module_error_new("Failed to register all imports to linker");
+      return doom_module_error_new_with_context(error, NULL, context);
+    }
+  }
+
+  *out = doom_module;
+  return NULL;
+}
+
+bool doom_module_pooled(doom_module_t *module) { return module->pooled; }
+
+static void doom_module_release(doom_module_t *module) {
+  if (atomic_fetch_sub(&module->references, 1) != 1) {
+    return;
+  }
+
+  if (module->linker) {
+    wasmtime_linker_delete(module->linker);
+  }
+  if (module->module) {
+    wasmtime_module_delete(module->module);
+  }
+  if (module->engine) {
+    wasm_engine_delete(module->engine);
+  }
+  free(module);
+}
+
+void doom_module_delete(doom_module_t *module) { doom_module_release(module); }
+
+doom_module_error_t *
+doom_module_instance_new_from_module(doom_module_t *module,
+                                     doom_module_config_t *config,
+                                     doom_module_instance_t **out) {
+  doom_module_context_t *context = malloc(sizeof(doom_module_context_t));
+  // Initialize entire context to 0
+  *context = (doom_module_context_t){0};
+
+  doom_module_instance_t *doom_instance =
+      malloc(sizeof(doom_module_instance_t));
+  // Initialize entire instance to 0
+  *doom_instance = (doom_module_instance_t){0};
+  doom_instance->context = context;
+  doom_instance->module = module;
+  doom_instance->storeData.config = config;
+
+  doom_instance->store =
+      wasmtime_store_new(module->engine, &doom_instance->storeData, NULL);
+  if (doom_instance->store == NULL) {
+    doom_module_instance_delete(doom_instance);
+    return doom_module_error_new("Failed to create WASM store");
+  }
   wasmtime_context_t *wasm_context =
       wasmtime_store_context(doom_instance->store);
-  error = wasmtime_linker_instantiate(doom_instance->linker, wasm_context,
-                                      doom_instance->module,
-                                      &doom_instance->instance, &trap);
+
+  wasmtime_linker_t *linker = module->linker;
+  if (module->builtWithThreads) {
+    wasmtime_error_t *error =
+        thread_spawner_new(module, config, &doom_instance->spawner);
+    if (error != NULL) {
+      doom_module_instance_delete(doom_instance);
+      doom_module_error_t *context =
+          doom_module_error_new("Failed to create shared memory");
+      return doom_module_error_new_with_context(error, NULL, context);
+    }
+
+    doom_instance->linker = linker = wasmtime_linker_new(module->engine);
+    error = register_all_needed_imports(linker);
+    if (error == NULL) {
+      error = define_threading_imports(linker, wasm_context,
+                                       doom_instance->spawner);
+    }
+    if (error != NULL) {
+      doom_module_instance_delete(doom_instance);
+      doom_module_error_t *context =
+          doom_module_error_new("Failed to register all imports to linker");
+      return doom_module_error_new_with_context(error, NULL, context);
+    }
+  }
+
+  wasm_trap_t *trap = NULL;
+  wasmtime_error_t *error = wasmtime_linker_instantiate(
+      linker, wasm_context, module->module, &doom_instance->instance, &trap);
   if (error != NULL || trap != NULL) {
     doom_module_instance_delete(doom_instance);
     doom_module_error_t *context =
@@ -372,176 +1172,173 @@ doom_module_error_t *doom_module_instance_new(const char *pathToWasmModule,
 
   // Correctly set up the `context` of this instance
   context->config = config;
+  context->storeData = &doom_instance->storeData;
   context->wasm_context = wasm_context;
   context->env_for_export_get = &doom_instance->instance;
   context->export_get = export_get_via_wasmtime_instance;
-
-  // Ensure that the module instance has all the expected exports
-  struct {
-    const char *name;
-    wasmtime_extern_kind_t kind;
-  } requiredExports[] = {
-      {"initGame", WASMTIME_EXTERN_FUNC},
-      {"tickGame", WASMTIME_EXTERN_FUNC},
-      {"reportKeyDown", WASMTIME_EXTERN_FUNC},
-      {"reportKeyUp", WASMTIME_EXTERN_FUNC},
-      {"memory", WASMTIME_EXTERN_MEMORY},
-      {"KEY_ALT", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_BACKSPACE", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_DOWNARROW", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_ENTER", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_ESCAPE", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_FIRE", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_LEFTARROW", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_RIGHTARROW", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_SHIFT", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_STRAFE_L", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_STRAFE_R", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_TAB", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_UPARROW", WASMTIME_EXTERN_GLOBAL},
-      {"KEY_USE", WASMTIME_EXTERN_GLOBAL},
-  };
-
-  for (int i = 0; i < ARRAY_LENGTH(requiredExports); i++) {
-    wasmtime_extern_t export;
-    doom_module_error_t *error = retrieve_export(
-        context, requiredExports[i].name, requiredExports[i].kind, &export);
-    if (error)
+  context->exports = &doom_instance->storeData.exports;
+  context->memory.exports = &doom_instance->storeData.exports;
+  context->memory.wasm_context = wasm_context;
+
+  // Imports called while the module was being instantiated may have already
+  // done this
+  if (!doom_instance->storeData.exports.resolved) {
+    doom_module_error_t *error = cached_exports_resolve(context);
+    if (error) {
+      doom_module_instance_delete(doom_instance);
       return error;
-    wasmtime_extern_delete(&export);
+    }
   }
 
   *out = doom_instance;
   return NULL;
 }
 
+// Creates a new `doom_module_instance_t`.
+doom_module_error_t *doom_module_instance_new(const char *pathToWasmModule,
+                                              doom_module_config_t *config,
+                                              doom_module_instance_t **out) {
+  doom_module_t *module = NULL;
+  doom_module_error_t *error = doom_module_new(pathToWasmModule, 0, &module);
+  if (error) {
+    return error;
+  }
+
+  printf("Instantiating module...\n");
+  error = doom_module_instance_new_from_module(module, config, out);
+  if (error) {
+    doom_module_delete(module);
+    return error;
+  }
+
+  (*out)->ownedModule = module;
+  return NULL;
+}
+
 void doom_module_instance_delete(doom_module_instance_t *instance) {
   // Note: There is no destructor associated with wasmtime_instance_t
 
-  if (instance->module) {
-    wasmtime_module_delete(instance->module);
-  }
+  cached_exports_release(&instance->storeData.exports);
   if (instance->linker) {
     wasmtime_linker_delete(instance->linker);
   }
   if (instance->store) {
     wasmtime_store_delete(instance->store);
   }
-  if (instance->engine) {
-    wasm_engine_delete(instance->engine);
+  if (instance->spawner) {
+    thread_spawner_release(instance->spawner);
+  }
+  if (instance->ownedModule) {
+    doom_module_delete(instance->ownedModule);
   }
 
   free(instance->context);
   free(instance);
 }
 
-// Define a few utilities to aid in the calling, by name, of an exported
-// function.
+// Calls one of the exported functions cached in `context->exports`.
 //
-// The names of these function follow the pattern
-// `call_exported_func__X__return_Y`, where:
-//  - X represents the input types, in order, accepted by the exported function.
-//  - Y represents the output types, in order, produced by the exported
-//  function.
-
+// `wasmtime_func_call_unchecked` skips the type-checking and boxing of each
+// argument and result that `wasmtime_func_call` does, which is safe because
+// the type of each cached function was checked when it was retrieved.
+// `argsAndResults` must be large enough to hold either the arguments or the
+// results, whichever there are more of. None of the cached functions returns
+// anything, so that's just the arguments.
 static doom_module_error_t *
-call_exported_func__void__return_void(doom_module_context_t *context,
-                                      const char *name) {
-  wasmtime_extern_t exportedFunction;
-  doom_module_error_t *error =
-      retrieve_export(context, name, WASMTIME_EXTERN_FUNC, &exportedFunction);
-  if (!error) {
-    wasm_trap_t *trap = NULL;
-    wasmtime_error_t *wasmtime_error =
-        wasmtime_func_call(context->wasm_context, &exportedFunction.of.func,
-                           NULL, 0, NULL, 0, &trap);
-    wasmtime_extern_delete(&exportedFunction);
-    if (wasmtime_error || trap) {
-      doom_module_error_t *context =
-          doom_module_error_new("Error while calling function `%s`", name);
-      error = doom_module_error_new_with_context(wasmtime_error, trap, context);
+call_cached_func(doom_module_context_t *context, wasmtime_extern_t *func,
+                 const char *name, wasmtime_val_raw_t *argsAndResults,
+                 size_t argsAndResultsLength) {
+  wasm_trap_t *trap = NULL;
+  wasmtime_error_t *wasmtime_error;
+  if (context->exports->checkedCalls) {
+    wasmtime_val_t args[1];
+    assert(argsAndResultsLength <= ARRAY_LENGTH(args));
+    for (size_t i = 0; i < argsAndResultsLength; i++) {
+      args[i].kind = WASMTIME_I32;
+      args[i].of.i32 = argsAndResults[i].i32;
     }
+    wasmtime_error =
+        wasmtime_func_call(context->wasm_context, &func->of.func, args,
+                           argsAndResultsLength, NULL, 0, &trap);
+  } else {
+    wasmtime_error = wasmtime_func_call_unchecked(
+        context->wasm_context, &func->of.func, argsAndResults,
+        argsAndResultsLength, &trap);
   }
-
-  return error;
-}
-
-static doom_module_error_t *
-call_exported_func__i32__return_void(doom_module_context_t *context,
-                                     const char *name, int32_t arg0) {
-  wasmtime_val_t params[1];
-  params[0].kind = WASMTIME_I32;
-  params[0].of.i32 = arg0;
-
-  wasmtime_extern_t exportedFunction;
-  doom_module_error_t *error =
-      retrieve_export(context, name, WASMTIME_EXTERN_FUNC, &exportedFunction);
-  if (!error) {
-    wasm_trap_t *trap = NULL;
-    wasmtime_error_t *wasmtime_error =
-        wasmtime_func_call(context->wasm_context, &exportedFunction.of.func,
-                           params, ARRAY_LENGTH(params), NULL, 0, &trap);
-    wasmtime_extern_delete(&exportedFunction);
-    if (wasmtime_error || trap) {
-      doom_module_error_t *context =
-          doom_module_error_new("Error while calling function `%s`", name);
-      error = doom_module_error_new_with_context(wasmtime_error, trap, context);
-    }
+  if (wasmtime_error || trap) {
+    doom_module_error_t *error =
+        doom_module_error_new("Error while calling function `%s`", name);
+    return doom_module_error_new_with_context(wasmtime_error, trap, error);
   }
-
-  return error;
+  return NULL;
 }
 
 // Define hooks to call any of the functions exported by the Doom WebAssembly
 // module
 
 doom_module_error_t *initGame(doom_module_context_t *context) {
-  return call_exported_func__void__return_void(context, "initGame");
+  wasmtime_val_raw_t argsAndResults[1];
+  return call_cached_func(context, &context->exports->initGame, "initGame",
+                          argsAndResults, 0);
 }
 
 doom_module_error_t *tickGame(doom_module_context_t *context) {
-  return call_exported_func__void__return_void(context, "tickGame");
+  wasmtime_val_raw_t argsAndResults[1];
+  return call_cached_func(context, &context->exports->tickGame, "tickGame",
+                          argsAndResults, 0);
 }
 
 doom_module_error_t *reportKeyDown(doom_module_context_t *context,
                                    int32_t doomKey) {
-  return call_exported_func__i32__return_void(context, "reportKeyDown",
-                                              doomKey);
+  wasmtime_val_raw_t argsAndResults[1];
+  argsAndResults[0].i32 = doomKey;
+  return call_cached_func(context, &context->exports->reportKeyDown,
+                          "reportKeyDown", argsAndResults,
+                          ARRAY_LENGTH(argsAndResults));
 }
 
 doom_module_error_t *reportKeyUp(doom_module_context_t *context,
                                  int32_t doomKey) {
-  return call_exported_func__i32__return_void(context, "reportKeyUp", doomKey);
+  wasmtime_val_raw_t argsAndResults[1];
+  argsAndResults[0].i32 = doomKey;
+  return call_cached_func(context, &context->exports->reportKeyUp,
+                          "reportKeyUp", argsAndResults,
+                          ARRAY_LENGTH(argsAndResults));
 }
 
-struct memory_reference {
-  wasmtime_extern_t exportedMemory;
-  wasmtime_context_t *wasm_context;
-};
-
 memory_reference_t *memory_reference_new(doom_module_context_t *context) {
-  memory_reference_t *ref = malloc(sizeof(memory_reference_t));
-
-  doom_module_error_t *error = retrieve_export(
-      context, "memory", WASMTIME_EXTERN_MEMORY, &ref->exportedMemory);
-  // Due to checks made when the related wasmtime_instance_t was created,
-  // we are confident that the retrieval 'memory' should have been successful,
-  // and so we just `assert` here.
-  assert(!error);
-
-  ref->wasm_context = context->wasm_context;
-
-  return ref;
+  // Every context carries its own reference, to the memory cached alongside
+  // its other exports, so there's nothing to look up or allocate here.
+  return &context->memory;
 }
 
 uint8_t *memory_reference_data(memory_reference_t *ref) {
-  return wasmtime_memory_data(ref->wasm_context,
-                              &ref->exportedMemory.of.memory);
+  cached_exports_t *exports = ref->exports;
+
+  if (exports->memory.kind == WASMTIME_EXTERN_SHAREDMEMORY) {
+    // A shared memory is reserved at its maximum size up front, as other
+    // threads may be using it while it grows, so its data never moves.
+    if (exports->memoryData == NULL) {
+      exports->memoryData =
+          wasmtime_sharedmemory_data(exports->memory.of.sharedmemory);
+    }
+    return exports->memoryData;
+  }
+
+  // A memory's data can only move when the memory grows, so only ask for it
+  // again when the memory's size has changed.
+  size_t size =
+      wasmtime_memory_data_size(ref->wasm_context, &exports->memory.of.memory);
+  if (size != exports->memorySize || exports->memoryData == NULL) {
+    exports->memoryData =
+        wasmtime_memory_data(ref->wasm_context, &exports->memory.of.memory);
+    exports->memorySize = size;
+  }
+  return exports->memoryData;
 }
 
 void memory_reference_delete(memory_reference_t *ref) {
-  wasmtime_extern_delete(&ref->exportedMemory);
-  free(ref);
+  // Nothing to do, the reference belongs to its context
 }
 
 #define CASE__RETURN_VALUE_AS_STRING(x)                                        \
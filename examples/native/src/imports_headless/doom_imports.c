@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <doom_imports.h>
+#include <doom_utils.h>
+#include <wad_loading.h>
+
+#include "headless_state.h"
+
+/*
+  This file implements all imports declared in doom_imports.h without any UI at
+  all: frames are thrown away (optionally after being hashed), and time only
+  passes when Doom asks what time it is. The state each instance needs is in a
+  `headless_state_t`, so these imports can serve many instances at once.
+
+  Its `run_game` is a microbenchmark of the cost of calling between the host
+  and the Doom WebAssembly module: it runs a fixed number of tics (set via the
+  DOOM_HEADLESS_TICS env var) of Doom's title screen and demos, and reports how
+  long it took to get to the first frame, how long the tics took, how many
+  imports were called per tic, and how long a single call of an export that
+  does next to nothing takes.
+*/
+
+#define DEFAULT_NUMBER_OF_TICS 2000
+#define NUMBER_OF_EMPTY_CALLS 1000000
+
+// Each call of `runtimeControl_timeInMilliseconds` advances time by this many
+// milliseconds, so Doom's wait for the next tic (it polls the time until
+// 1000/35 milliseconds have passed) takes the same number of calls every tic.
+#define MILLISECONDS_PER_TIME_CHECK 1
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325
+#define FNV_PRIME 0x100000001b3
+
+static uint64_t processStartTime;
+
+static uint64_t nanoseconds_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Runs before `main`, so that the time to the first frame includes loading and
+// compiling (or loading an already compiled) Doom WebAssembly module.
+__attribute__((constructor)) static void record_process_start_time() {
+  processStartTime = nanoseconds_now();
+}
+
+static int number_of_tics_to_run() {
+  const char *value = getenv("DOOM_HEADLESS_TICS");
+  int tics = value ? atoi(value) : 0;
+  return tics > 0 ? tics : DEFAULT_NUMBER_OF_TICS;
+}
+
+/*
+ * Returns a non-NULL error if there was an issue when running the game,
+ * otherwise NULL is returned on success.
+ */
+doom_module_error_t *run_game(doom_module_context_t *context) {
+  headless_state_t state = {0};
+  doom_module_context_set_host_state(context, &state);
+
+  doom_module_error_t *error = initGame(context);
+  if (error) {
+    return error;
+  }
+
+  int tics = number_of_tics_to_run();
+  uint64_t importCallsBefore = state.importCalls;
+  uint64_t framesBefore = state.framesDrawn;
+  uint64_t start = nanoseconds_now();
+  for (int i = 0; !error && i < tics; i++) {
+    error = tickGame(context);
+  }
+  uint64_t ticTime = nanoseconds_now() - start;
+  if (error) {
+    return error;
+  }
+
+  // A key that's reported as released, but was never pressed, costs Doom
+  // nothing beyond the call itself
+  start = nanoseconds_now();
+  for (int i = 0; !error && i < NUMBER_OF_EMPTY_CALLS; i++) {
+    error = reportKeyUp(context, 0);
+  }
+  uint64_t emptyCallTime = nanoseconds_now() - start;
+  if (error) {
+    return error;
+  }
+
+  printf("first frame:   %.1f ms after the process started\n",
+         (state.firstFrameTime - processStartTime) / 1e6);
+  printf("tickGame:      %d calls, %.3f ms per call\n", tics,
+         ticTime / 1e6 / tics);
+  printf("imports:       %.1f calls per tickGame call, %.1f frames drawn per "
+         "tickGame call\n",
+         (double)(state.importCalls - importCallsBefore) / tics,
+         (double)(state.framesDrawn - framesBefore) / tics);
+  printf("reportKeyUp:   %d calls, %.1f ns per call\n", NUMBER_OF_EMPTY_CALLS,
+         (double)emptyCallTime / NUMBER_OF_EMPTY_CALLS);
+
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////
+// Implementation of all Doom WebAssembly imports
+//
+// See doom_imports.h, or the SDL implementation of these same imports, for
+// documentation of what each import is expected to do.
+////////////////////////////////////////////////////////////
+
+void loading_onGameInit(doom_module_context_t *context, int32_t width,
+                        int32_t height) {
+  headless_state_t *state = doom_module_context_host_state(context);
+  state->importCalls++;
+  state->frameWidth = width;
+  state->frameHeight = height;
+  state->framesChecksum = FNV_OFFSET_BASIS;
+}
+
+void loading_wadSizes(doom_module_context_t *context,
+                      int32_t numberOfWadsOffset,
+                      int32_t numberOfTotalBytesInAllWadsOffset) {
+  headless_state_t *state = doom_module_context_host_state(context);
+  state->importCalls++;
+  wad_files_report_sizes(context, numberOfWadsOffset,
+                         numberOfTotalBytesInAllWadsOffset, &state->wads);
+}
+
+void loading_readWads(doom_module_context_t *context,
+                      int32_t wadDataDestinationOffset,
+                      int32_t byteLengthOfEachWadOffset) {
+  headless_state_t *state = doom_module_context_host_state(context);
+  state->importCalls++;
+  wad_files_copy_to_memory(context, state->wads, wadDataDestinationOffset,
+                           byteLengthOfEachWadOffset);
+  state->wads = NULL;
+}
+
+int64_t runtimeControl_timeInMilliseconds(doom_module_context_t *context) {
+  headless_state_t *state = doom_module_context_host_state(context);
+  state->importCalls++;
+  state->currentTime += MILLISECONDS_PER_TIME_CHECK;
+  return state->currentTime;
+}
+
+void ui_drawFrame(doom_module_context_t *context, int32_t screenBufferOffset) {
+  headless_state_t *state = doom_module_context_host_state(context);
+  state->importCalls++;
+  if (state->framesDrawn++ == 0) {
+    state->firstFrameTime = nanoseconds_now();
+  }
+
+  if (state->checksumFrames) {
+    // 64-bit FNV-1a, a pixel at a time
+    memory_reference_t *mem_ref = memory_reference_new(context);
+    const uint8_t *pixels = memory_reference_data(mem_ref) + screenBufferOffset;
+    uint64_t hash = state->framesChecksum;
+    size_t numberOfPixels = (size_t)state->frameWidth * state->frameHeight;
+    for (size_t i = 0; i < numberOfPixels; i++) {
+      uint32_t pixel;
+      memcpy(&pixel, pixels + i * sizeof(pixel), sizeof(pixel));
+      hash ^= pixel;
+      hash *= FNV_PRIME;
+    }
+    state->framesChecksum = hash;
+    memory_reference_delete(mem_ref);
+  }
+}
+
+int32_t gameSaving_sizeOfSaveGame(doom_module_context_t *context,
+                                  int32_t gameSaveId) {
+  headless_state_t *state = doom_module_context_host_state(context);
+  state->importCalls++;
+  return 0;
+}
+
+int32_t gameSaving_readSaveGame(doom_module_context_t *context,
+                                int32_t gameSaveId,
+                                int32_t dataDestinationOffset) {
+  headless_state_t *state = doom_module_context_host_state(context);
+  state->importCalls++;
+  return 0;
+}
+
+int32_t gameSaving_writeSaveGame(doom_module_context_t *context,
+                                 int32_t gameSaveId, int32_t dataOffset,
+                                 int32_t length) {
+  // Saving games isn't supported
+  headless_state_t *state = doom_module_context_host_state(context);
+  state->importCalls++;
+  return 0;
+}
+
+void console_onInfoMessage(doom_module_context_t *context,
+                           int32_t messageOffset, int32_t length) {
+  headless_state_t *state = doom_module_context_host_state(context);
+  state->importCalls++;
+  if (state->quiet) {
+    return;
+  }
+  memory_reference_t *mem_ref = memory_reference_new(context);
+  char *message = (char *)(memory_reference_data(mem_ref) + messageOffset);
+  fprintf(stdout, "%.*s\n", length, message);
+  memory_reference_delete(mem_ref);
+}
+
+void console_onErrorMessage(doom_module_context_t *context,
+                            int32_t messageOffset, int32_t length) {
+  headless_state_t *state = doom_module_context_host_state(context);
+  state->importCalls++;
+  memory_reference_t *mem_ref = memory_reference_new(context);
+  char *message = (char *)(memory_reference_data(mem_ref) + messageOffset);
+  fprintf(stderr, "%.*s\n", length, message);
+  memory_reference_delete(mem_ref);
+}
@@ -0,0 +1,38 @@
+#ifndef HEADLESS_STATE_H_
+#define HEADLESS_STATE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The state kept by the headless imports for each instance of the Doom
+// WebAssembly module, attached to it via `doom_module_context_set_host_state`
+// before `initGame` is called.
+//
+// Zero-initialized is a valid starting state.
+typedef struct headless_state {
+  // Options, set before `initGame` is called
+
+  // Whether to compute `framesChecksum`
+  bool checksumFrames;
+  // Whether to hide info messages from Doom (error messages are still shown)
+  bool quiet;
+
+  // Internal
+
+  // The WAD files to load, between `loading_wadSizes` and `loading_readWads`
+  struct wad_files *wads;
+
+  // Results
+
+  int64_t currentTime;
+  uint64_t importCalls;
+  uint64_t framesDrawn;
+  // Of the first frame, in nanoseconds of CLOCK_MONOTONIC
+  uint64_t firstFrameTime;
+  int32_t frameWidth;
+  int32_t frameHeight;
+  // A hash of the pixels of every frame drawn so far
+  uint64_t framesChecksum;
+} headless_state_t;
+
+#endif
@@ -1,11 +1,15 @@
 #include <assert.h>
+#include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <errno.h>
 #include <SDL.h>
 
 #include <doom_imports.h>
 #include <doom_utils.h>
+#include <wad_loading.h>
 
 // Associate some appropriate SDL_KeyCode values directly with enum DoomKeyLabel
 // values
@@ -32,53 +36,335 @@ static struct {
     {SDLK_RALT, KEY_ALT},
 };
 
+/*
+  Doom is simulated and presented on separate threads, so that a slow (e.g.
+  vsync-blocked) present never delays the next tic:
+  - The main thread owns the SDL window: it polls SDL for events, queues key
+    events for the simulation, and presents the latest finished frame.
+  - The simulation thread calls `tickGame`, after reporting the key events
+    queued since the previous tic, and so is the only thread that calls into
+    the Doom WebAssembly module once `initGame` has returned. `ui_drawFrame`
+    copies each frame into a triple buffer, and never touches SDL.
+
+  Setting the DOOM_SDL_SINGLE_THREAD env var does all of this on the main
+  thread instead, a tic then a present, for comparison.
+
+  Setting the DOOM_SDL_STATS env var to a number of seconds runs Doom for that
+  long, pressing and releasing a key every STATS_KEY_INTERVAL_MS, then reports
+  the jitter of the interval between tics and the latency from a key event
+  being polled to it being reported to Doom.
+*/
+
+#define NUMBER_OF_FRAME_BUFFERS 3
+// Set in `sdl_state_t.latestFrame` when the frame there hasn't been presented
+#define FRAME_IS_NEW 0x100
+#define INPUT_QUEUE_CAPACITY 256
+// How long the main thread waits for a new frame before polling SDL again
+#define PRESENT_WAIT_MS 10
+#define STATS_KEY_INTERVAL_MS 100
+
+typedef struct key_event {
+  bool down;
+  SDL_Keycode keyCode;
+  // When the event was polled, via SDL_GetPerformanceCounter
+  Uint64 time;
+} key_event_t;
+
+typedef struct sdl_stats {
+  bool enabled;
+  Uint64 end;
+  Uint64 nextKeyEvent;
+  bool keyIsDown;
+
+  Uint64 lastTic;
+  uint64_t tics;
+  double ticIntervalSum;
+  double ticIntervalSquaresSum;
+  double ticIntervalMax;
+
+  uint64_t keyEvents;
+  double keyLatencySum;
+  double keyLatencyMax;
+
+  SDL_atomic_t framesDrawn;
+  uint64_t framesPresented;
+} sdl_stats_t;
+
+// The state of each instance of the Doom WebAssembly module, attached to it via
+// `doom_module_context_set_host_state`
+typedef struct sdl_state {
+  // Only used by the main thread
+
+  SDL_Window *window;
+  SDL_Texture *texture;
+  // Index of the frame buffer being presented
+  int presentingFrame;
+
+  // Only used by the thread calling into the Doom WebAssembly module
+
+  // The WAD files to load, between `loading_wadSizes` and `loading_readWads`
+  wad_files_t *wads;
+  // Index of the frame buffer being drawn to
+  int drawingFrame;
+  doom_module_error_t *simulationError;
+
+  // Shared by both threads
+
+  // The most recently finished frame waits in the frame buffer that's neither
+  // being drawn to nor presented, whose index (along with FRAME_IS_NEW, if it
+  // hasn't been presented yet) is in `latestFrame`. Each thread swaps its own
+  // frame buffer with that one, so a frame is never copied between buffers.
+  uint32_t *frames[NUMBER_OF_FRAME_BUFFERS];
+  size_t frameSize;
+  SDL_atomic_t latestFrame;
+  SDL_sem *frameFinished;
+
+  SDL_mutex *inputLock;
+  key_event_t inputQueue[INPUT_QUEUE_CAPACITY];
+  int inputQueueLength;
+
+  SDL_atomic_t quit;
+  SDL_atomic_t simulationDone;
+
+  sdl_stats_t stats;
+} sdl_state_t;
+
+static double milliseconds_between(Uint64 start, Uint64 end) {
+  return (double)(end - start) * 1000 / SDL_GetPerformanceFrequency();
+}
+
+static doom_module_error_t *report_key_event(doom_module_context_t *context,
+                                             key_event_t *event) {
+  // By default the doom key for a given keyboard key is the unicode value
+  // representing the unmodified character that would be generated by pressing
+  // the key
+  int32_t doomKey = event->keyCode;
+
+  // Some SDL_Keycode values map, semantically, to values of enum DoomKeyLabel
+  // though (e.g. SDLK_SPACE maps to KEY_USE), and we'll check for such a case
+  // here.
+  for (int i = 0; i < ARRAY_LENGTH(doomKeyLabelForSdlKeyCodes); i++) {
+    if (doomKeyLabelForSdlKeyCodes[i].sdlKeyCode == event->keyCode) {
+      // In the case that we find an enum DoomKeyLabel value associated with the
+      // pressed/unpressed SDL_Keycode value, the doom key value we should use
+      // will be retrieved by calling `doomKeyForLabel`
+      doom_module_error_t *error = doomKeyForLabel(
+          context, doomKeyLabelForSdlKeyCodes[i].label, &doomKey);
+      if (error) {
+        return error;
+      }
+      break;
+    }
+  }
+
+  if (0 <= doomKey && doomKey <= 255) {
+    return event->down ? reportKeyDown(context, doomKey)
+                       : reportKeyUp(context, doomKey);
+  }
+  return NULL;
+}
+
+// Reports the key events queued since the previous tic, then runs a tic.
+static doom_module_error_t *simulate(doom_module_context_t *context,
+                                     sdl_state_t *state) {
+  key_event_t events[INPUT_QUEUE_CAPACITY];
+  SDL_LockMutex(state->inputLock);
+  int numberOfEvents = state->inputQueueLength;
+  memcpy(events, state->inputQueue, numberOfEvents * sizeof(key_event_t));
+  state->inputQueueLength = 0;
+  SDL_UnlockMutex(state->inputLock);
+
+  sdl_stats_t *stats = &state->stats;
+  Uint64 now = SDL_GetPerformanceCounter();
+  for (int i = 0; i < numberOfEvents; i++) {
+    doom_module_error_t *error = report_key_event(context, &events[i]);
+    if (error) {
+      return error;
+    }
+
+    double latency = milliseconds_between(events[i].time, now);
+    stats->keyEvents++;
+    stats->keyLatencySum += latency;
+    stats->keyLatencyMax = SDL_max(stats->keyLatencyMax, latency);
+  }
+
+  doom_module_error_t *error = tickGame(context);
+
+  now = SDL_GetPerformanceCounter();
+  if (stats->lastTic != 0) {
+    double interval = milliseconds_between(stats->lastTic, now);
+    stats->tics++;
+    stats->ticIntervalSum += interval;
+    stats->ticIntervalSquaresSum += interval * interval;
+    stats->ticIntervalMax = SDL_max(stats->ticIntervalMax, interval);
+  }
+  stats->lastTic = now;
+
+  return error;
+}
+
+static int run_simulation(void *data) {
+  doom_module_context_t *context = data;
+  sdl_state_t *state = doom_module_context_host_state(context);
+  while (!state->simulationError && !SDL_AtomicGet(&state->quit)) {
+    state->simulationError = simulate(context, state);
+  }
+  SDL_AtomicSet(&state->simulationDone, 1);
+  // Wake the main thread, so it notices right away
+  SDL_SemPost(state->frameFinished);
+  return 0;
+}
+
+static void queue_key_event(sdl_state_t *state, bool down,
+                            SDL_Keycode keyCode) {
+  key_event_t event = {down, keyCode, SDL_GetPerformanceCounter()};
+  SDL_LockMutex(state->inputLock);
+  // Only a simulation that's stalled for a very long time lets the queue fill
+  // up, and then dropping input is as good as anything
+  if (state->inputQueueLength < INPUT_QUEUE_CAPACITY) {
+    state->inputQueue[state->inputQueueLength++] = event;
+  }
+  SDL_UnlockMutex(state->inputLock);
+}
+
+// Polls SDL for events, queuing key events for the simulation. Returns false
+// once Doom should quit.
+static bool poll_events(sdl_state_t *state) {
+  sdl_stats_t *stats = &state->stats;
+  if (stats->enabled) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now >= stats->end) {
+      return false;
+    }
+    if (now >= stats->nextKeyEvent) {
+      stats->keyIsDown = !stats->keyIsDown;
+      SDL_Event e = {0};
+      e.type = stats->keyIsDown ? SDL_KEYDOWN : SDL_KEYUP;
+      e.key.keysym.sym = SDLK_LSHIFT;
+      SDL_PushEvent(&e);
+      stats->nextKeyEvent =
+          now + SDL_GetPerformanceFrequency() * STATS_KEY_INTERVAL_MS / 1000;
+    }
+  }
+
+  SDL_Event e;
+  while (SDL_PollEvent(&e)) {
+    if (e.type == SDL_QUIT) {
+      return false;
+    } else if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
+      queue_key_event(state, e.type == SDL_KEYDOWN, e.key.keysym.sym);
+    }
+  }
+  return true;
+}
+
+// Presents the most recently finished frame, if it hasn't been presented yet.
+static void present_latest_frame(sdl_state_t *state) {
+  if (!(SDL_AtomicGet(&state->latestFrame) & FRAME_IS_NEW)) {
+    return;
+  }
+  // Only this thread clears FRAME_IS_NEW, so what's swapped in is new
+  state->presentingFrame =
+      SDL_AtomicSet(&state->latestFrame, state->presentingFrame) &
+      ~FRAME_IS_NEW;
+
+  int textureWidth;
+  SDL_QueryTexture(state->texture, NULL, NULL, &textureWidth, NULL);
+  SDL_UpdateTexture(state->texture, NULL, state->frames[state->presentingFrame],
+                    textureWidth * sizeof(uint32_t));
+
+  SDL_Renderer *renderer = SDL_GetRenderer(state->window);
+  SDL_RenderClear(renderer);
+  SDL_RenderCopy(renderer, state->texture, NULL, NULL);
+  SDL_RenderPresent(renderer);
+  state->stats.framesPresented++;
+}
+
+static void print_stats(sdl_stats_t *stats, bool singleThread) {
+  double ticMean = 0;
+  double ticVariance = 0;
+  if (stats->tics > 0) {
+    ticMean = stats->ticIntervalSum / stats->tics;
+    ticVariance =
+        stats->ticIntervalSquaresSum / stats->tics - ticMean * ticMean;
+  }
+  printf("threads:       simulation and presentation on %s\n",
+         singleThread ? "one thread" : "separate threads");
+  printf("tickGame:      %" PRIu64 " intervals, mean %.3f ms, std dev %.3f ms, "
+         "max %.3f ms\n",
+         stats->tics, ticMean, SDL_sqrt(SDL_max(ticVariance, 0)),
+         stats->ticIntervalMax);
+  printf("key events:    %" PRIu64 ", latency to their tic mean %.3f ms, max "
+         "%.3f ms\n",
+         stats->keyEvents,
+         stats->keyEvents ? stats->keyLatencySum / stats->keyEvents : 0,
+         stats->keyLatencyMax);
+  printf("frames:        %d drawn, %" PRIu64 " presented\n",
+         SDL_AtomicGet(&stats->framesDrawn), stats->framesPresented);
+}
+
 /*
  * Returns a non-NULL error if there was an issue when running the game,
  * otherwise NULL is returned on success.
  */
 doom_module_error_t *run_game(doom_module_context_t *context) {
+  sdl_state_t state = {0};
+  state.inputLock = SDL_CreateMutex();
+  state.frameFinished = SDL_CreateSemaphore(0);
+  SDL_AtomicSet(&state.latestFrame, 2);
+  state.drawingFrame = 0;
+  state.presentingFrame = 1;
+
+  const char *statsSeconds = getenv("DOOM_SDL_STATS");
+  if (statsSeconds) {
+    state.stats.enabled = true;
+    state.stats.end = SDL_GetPerformanceCounter() +
+                      SDL_GetPerformanceFrequency() * atof(statsSeconds);
+  }
+  doom_module_context_set_host_state(context, &state);
+
+  // On this thread, as `loading_onGameInit` creates the window
   doom_module_error_t *error = initGame(context);
 
-  while (!error) {
-    error = tickGame(context);
-
-    SDL_Event e;
-    while (!error && SDL_PollEvent(&e)) {
-      if (e.type == SDL_QUIT) {
-        atexit(SDL_Quit);
-        return NULL; // Game ran to successful completion!
-      } else if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
-        // By default the doom key for a given keyboard key is the unicode value
-        // representing the unmodified character that would be generated by
-        // pressing the key
-        int32_t doomKey = e.key.keysym.sym;
-
-        // Some SDL_Keycode values map, semantically, to values of enum
-        // DoomKeyLabel though (e.g. SDLK_SPACE maps to KEY_USE), and we'll
-        // check for such a case here.
-        for (int i = 0; i < ARRAY_LENGTH(doomKeyLabelForSdlKeyCodes); i++) {
-          if (doomKeyLabelForSdlKeyCodes[i].sdlKeyCode == e.key.keysym.sym) {
-            // In the case that we find an enum DoomKeyLabel value associated
-            // with the pressed/unpressed SDL_Keycode value, the doom key value
-            // we should use will be retrieved by calling `doomKeyForLabel`
-            error = doomKeyForLabel(
-                context, doomKeyLabelForSdlKeyCodes[i].label, &doomKey);
-            break;
-          }
-        }
-
-        if (!error && 0 <= doomKey && doomKey <= 255) {
-          if (e.type == SDL_KEYDOWN) {
-            error = reportKeyDown(context, doomKey);
-          } else {
-            error = reportKeyUp(context, doomKey);
-          }
-        }
-      }
+  bool singleThread = getenv("DOOM_SDL_SINGLE_THREAD") != NULL;
+  SDL_Thread *simulation = NULL;
+  if (!error && !singleThread) {
+    simulation = SDL_CreateThread(run_simulation, "simulation", context);
+    singleThread = simulation == NULL;
+  }
+
+  bool quit = false;
+  if (!error && simulation) {
+    while (!quit && !SDL_AtomicGet(&state.simulationDone)) {
+      quit = !poll_events(&state);
+      SDL_SemWaitTimeout(state.frameFinished, PRESENT_WAIT_MS);
+      present_latest_frame(&state);
+    }
+    SDL_AtomicSet(&state.quit, 1);
+    SDL_WaitThread(simulation, NULL);
+    error = state.simulationError;
+  } else {
+    while (!error && !quit) {
+      error = simulate(context, &state);
+      quit = !poll_events(&state);
+      present_latest_frame(&state);
     }
   }
 
-  return error;
+  if (state.stats.enabled && !error) {
+    print_stats(&state.stats, singleThread);
+  }
+
+  for (int i = 0; i < NUMBER_OF_FRAME_BUFFERS; i++) {
+    free(state.frames[i]);
+  }
+  SDL_DestroySemaphore(state.frameFinished);
+  SDL_DestroyMutex(state.inputLock);
+
+  if (quit && !error) {
+    atexit(SDL_Quit);
+  }
+  return error; // NULL if the game ran to successful completion!
 }
 
 #define SAVE_GAME_FOLDER "./.savegame"
@@ -112,19 +398,6 @@ static bool running_on_little_endian() {
 // Implementation of all Doom WebAssembly imports
 ////////////////////////////////////////////////////////////
 
-// State shared between functions
-//
-// Note: due to use of this shared global state, these functions, imported into
-// a Doom WebAssembly module, can't currently be imported by more than one Doom
-// WebAssembly module.
-//
-// Removing this restriction shouldn't be that difficult (implementation sketch:
-// users of `doom_module_context_t` are given the new ability to associate
-// (attach and retrieve) their own custom state to an instance of the Doom
-// WebAssembly module) but this isn't being addressed now.
-static SDL_Window *window;
-static SDL_Texture *texture;
-
 /*
  * Perform one-time initialization upon Doom first starting up
  *
@@ -142,18 +415,19 @@ static SDL_Texture *texture;
  */
 void loading_onGameInit(doom_module_context_t *context, int32_t width,
                         int32_t height) {
-  // This code currently depends upon some global state, so `loading_onGameInit`
-  // can only be called once. Fail hard here if this isn't the first time
-  // `loading_onGameInit` has been called.
-  assert(window == NULL && texture == NULL &&
+  sdl_state_t *state = doom_module_context_host_state(context);
+
+  // Fail hard here if this isn't the first time `loading_onGameInit` has been
+  // called for this instance.
+  assert(state->window == NULL && state->texture == NULL &&
          "`window` or `texture` were not NULL, was `loading_onGameInit` called "
          "twice?");
 
   // Setup SDL window and renderer
   SDL_Renderer *renderer;
-  SDL_CreateWindowAndRenderer(width, height, SDL_WINDOW_SHOWN, &window,
+  SDL_CreateWindowAndRenderer(width, height, SDL_WINDOW_SHOWN, &state->window,
                               &renderer);
-  SDL_SetWindowTitle(window, "DOOM");
+  SDL_SetWindowTitle(state->window, "DOOM");
 
   // Doom Frame buffer pixels are 32-bit values with their 8-bit color
   // components logically ordered "ARGB", but this 32-bit value is stored in
@@ -168,8 +442,13 @@ void loading_onGameInit(doom_module_context_t *context, int32_t width,
   // (i.e. opposite WebAssembly), respectively.
   Uint32 pixelFormat = running_on_little_endian() ? SDL_PIXELFORMAT_XRGB8888
                                                   : SDL_PIXELFORMAT_BGRX8888;
-  texture = SDL_CreateTexture(renderer, pixelFormat, SDL_TEXTUREACCESS_TARGET,
-                              width, height);
+  state->texture = SDL_CreateTexture(
+      renderer, pixelFormat, SDL_TEXTUREACCESS_TARGET, width, height);
+
+  state->frameSize = (size_t)width * height * sizeof(uint32_t);
+  for (int i = 0; i < NUMBER_OF_FRAME_BUFFERS; i++) {
+    state->frames[i] = calloc(1, state->frameSize);
+  }
 }
 
 /*
@@ -213,30 +492,9 @@ void loading_onGameInit(doom_module_context_t *context, int32_t width,
 void loading_wadSizes(doom_module_context_t *context,
                       int32_t numberOfWadsOffset,
                       int32_t numberOfTotalBytesInAllWadsOffset) {
-  // We're just going to assume that the sum of the sizes in bytes of all WADs
-  // never exceeds 2GB, and so this sum can fit into a signed 32-bit int.
-  // Therefore we'll never be checking for overflow.
-  int32_t numberOfTotalBytesInAllWads = 0;
-  doom_module_config_t *config = doom_module_context_config(context);
-  for (int i = 0; i < config->numberOfWadFiles; i++) {
-    FILE *file = fopen(config->pathsToWadFiles[i], "rb");
-    assert(file != NULL && "Failed to open a WAD file");
-    fseek(file, 0L, SEEK_END);
-    size_t file_size = ftell(file);
-    fclose(file);
-
-    numberOfTotalBytesInAllWads += file_size;
-  }
-
-  memory_reference_t *mem_ref = memory_reference_new(context);
-
-  write_i32_to_wasm_memory(memory_reference_data(mem_ref) + numberOfWadsOffset,
-                           config->numberOfWadFiles);
-  write_i32_to_wasm_memory(memory_reference_data(mem_ref) +
-                               numberOfTotalBytesInAllWadsOffset,
-                           numberOfTotalBytesInAllWads);
-
-  memory_reference_delete(mem_ref);
+  sdl_state_t *state = doom_module_context_host_state(context);
+  wad_files_report_sizes(context, numberOfWadsOffset,
+                         numberOfTotalBytesInAllWadsOffset, &state->wads);
 }
 
 /*
@@ -276,30 +534,10 @@ void loading_wadSizes(doom_module_context_t *context,
 void loading_readWads(doom_module_context_t *context,
                       int32_t wadDataDestinationOffset,
                       int32_t byteLengthOfEachWadOffset) {
-  memory_reference_t *mem_ref = memory_reference_new(context);
-
-  uint8_t *dataDest = memory_reference_data(mem_ref) + wadDataDestinationOffset;
-  uint8_t *byteLengthDest =
-      memory_reference_data(mem_ref) + byteLengthOfEachWadOffset;
-
-  doom_module_config_t *config = doom_module_context_config(context);
-  for (int i = 0; i < config->numberOfWadFiles; i++) {
-    FILE *file = fopen(config->pathsToWadFiles[i], "rb");
-    assert(file != NULL && "Failed to open a WAD file");
-    fseek(file, 0L, SEEK_END);
-    size_t file_size = ftell(file);
-    fseek(file, 0L, SEEK_SET);
-    size_t numRead = fread(dataDest, file_size, 1, file);
-    assert(numRead == 1 && "Failed to successfully read a WAD file");
-    fclose(file);
-
-    write_i32_to_wasm_memory(byteLengthDest, file_size);
-
-    dataDest += file_size;
-    byteLengthDest += 4;
-  }
-
-  memory_reference_delete(mem_ref);
+  sdl_state_t *state = doom_module_context_host_state(context);
+  wad_files_copy_to_memory(context, state->wads, wadDataDestinationOffset,
+                           byteLengthOfEachWadOffset);
+  state->wads = NULL;
 }
 
 /*
@@ -348,19 +586,20 @@ int64_t runtimeControl_timeInMilliseconds(doom_module_context_t *context) {
  * Implements Doom import: function ui.drawFrame(i32) -> ()
  */
 void ui_drawFrame(doom_module_context_t *context, int32_t screenBufferOffset) {
-  int textureWidth;
-  SDL_QueryTexture(texture, NULL, NULL, &textureWidth, NULL);
+  sdl_state_t *state = doom_module_context_host_state(context);
 
+  // Copy the frame out now, as Doom will draw the next one over it, and hand it
+  // to the main thread to present
   memory_reference_t *mem_ref = memory_reference_new(context);
-  SDL_UpdateTexture(texture, NULL,
-                    memory_reference_data(mem_ref) + screenBufferOffset,
-                    textureWidth * sizeof(uint32_t));
+  memcpy(state->frames[state->drawingFrame],
+         memory_reference_data(mem_ref) + screenBufferOffset, state->frameSize);
   memory_reference_delete(mem_ref);
 
-  SDL_Renderer *renderer = SDL_GetRenderer(window);
-  SDL_RenderClear(renderer);
-  SDL_RenderCopy(renderer, texture, NULL, NULL);
-  SDL_RenderPresent(renderer);
+  state->drawingFrame =
+      SDL_AtomicSet(&state->latestFrame, state->drawingFrame | FRAME_IS_NEW) &
+      ~FRAME_IS_NEW;
+  SDL_SemPost(state->frameFinished);
+  SDL_AtomicIncRef(&state->stats.framesDrawn);
 }
 
 /*
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "doom_exports.h"
+#include "doom_utils.h"
+
+/*
+  A benchmark of how many instances of the Doom WebAssembly module can be
+  created (and deleted) per second, one after the other, both with and without
+  the memory for instances being set aside up front and reused.
+*/
+
+#define DEFAULT_NUMBER_OF_INSTANCES 1000
+
+// How many instances are set aside up front when they're reused
+#define POOLED_INSTANCES 16
+
+static uint64_t nanoseconds_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Creates, then deletes, `count` instances of `module` one after the other,
+// reporting how many were created per second.
+static doom_module_error_t *time_instances(doom_module_t *module,
+                                          doom_module_config_t *config,
+                                          int count, const char *label) {
+  uint64_t start = nanoseconds_now();
+  for (int i = 0; i < count; i++) {
+    doom_module_instance_t *instance = NULL;
+    doom_module_error_t *error =
+        doom_module_instance_new_from_module(module, config, &instance);
+    if (error) {
+      return error;
+    }
+    doom_module_instance_delete(instance);
+  }
+  uint64_t elapsed = nanoseconds_now() - start;
+
+  printf("%s: %d instances, %.1f us per instance, %.0f instances per second\n",
+         label, count, elapsed / 1e3 / count, count / (elapsed / 1e9));
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Usage: %s path-to-Doom-WebAssembly-module [numberOfInstances]\n",
+           argv[0]);
+    return 1;
+  }
+
+  const char *pathToDoomWasmModule = argv[1];
+  int count = argc > 2 ? atoi(argv[2]) : DEFAULT_NUMBER_OF_INSTANCES;
+  if (count <= 0) {
+    count = DEFAULT_NUMBER_OF_INSTANCES;
+  }
+
+  doom_module_config_t config;
+  config.numberOfWadFiles = 0;
+  config.pathsToWadFiles = NULL;
+
+  struct {
+    const char *label;
+    uint32_t maxInstances;
+  } runs[] = {
+      {"allocated one by one", 0},
+      {"pooled", POOLED_INSTANCES},
+  };
+
+  doom_module_error_t *error = NULL;
+  for (int i = 0; !error && i < ARRAY_LENGTH(runs); i++) {
+    doom_module_t *module = NULL;
+    error =
+        doom_module_new(pathToDoomWasmModule, runs[i].maxInstances, &module);
+    if (!error) {
+      if (runs[i].maxInstances > 0 && !doom_module_pooled(module)) {
+        printf("%s: skipped, as the Wasmtime this was built with can't pool "
+               "instances\n",
+               runs[i].label);
+      } else {
+        error = time_instances(module, &config, count, runs[i].label);
+      }
+      doom_module_delete(module);
+    }
+  }
+
+  if (error) {
+    fprintf(stderr, "An error occurred!\n%s\n", error->message);
+    doom_module_error_delete(error);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "doom_utils.h"
+#include "wad_loading.h"
+
+typedef struct wad_file {
+  const uint8_t *data;
+  size_t size;
+} wad_file_t;
+
+struct wad_files {
+  int32_t count;
+  wad_file_t *files;
+};
+
+// Doom can't go on without a WAD it was given, and the imports have no way of
+// handing an error back to it, so this reports what failed (and why) and exits
+static void exit_on_wad_error(const char *failure, const char *path) {
+  fprintf(stderr, "An error occurred!\n%s '%s': %s\n", failure, path,
+          strerror(errno));
+  exit(EXIT_FAILURE);
+}
+
+void wad_files_report_sizes(doom_module_context_t *context,
+                            int32_t numberOfWadsOffset,
+                            int32_t numberOfTotalBytesInAllWadsOffset,
+                            wad_files_t **out) {
+  doom_module_config_t *config = doom_module_context_config(context);
+  if (config->numberOfWadFiles == 0) {
+    // Doom will load the shareware WAD, and never call `loading_readWads`
+    *out = NULL;
+    return;
+  }
+
+  wad_files_t *wads = malloc(sizeof(wad_files_t));
+  wads->count = config->numberOfWadFiles;
+  wads->files = calloc(wads->count, sizeof(wad_file_t));
+
+  // We're just going to assume that the sum of the sizes in bytes of all WADs
+  // never exceeds 2GB, and so this sum can fit into a signed 32-bit int.
+  // Therefore we'll never be checking for overflow.
+  int32_t numberOfTotalBytesInAllWads = 0;
+  for (int i = 0; i < wads->count; i++) {
+    const char *path = config->pathsToWadFiles[i];
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+      exit_on_wad_error("Failed to open the WAD file", path);
+    }
+    struct stat stats;
+    if (fstat(fd, &stats) != 0) {
+      exit_on_wad_error("Failed to find the size of the WAD file", path);
+    }
+
+    wad_file_t *file = &wads->files[i];
+    file->size = stats.st_size;
+    // A file of no bytes can't be mapped, but then there's nothing to copy
+    if (file->size > 0) {
+      void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        exit_on_wad_error("Failed to memory-map the WAD file", path);
+      }
+      // Each WAD is read from start to end just once, and soon. madvise
+      // takes one piece of advice at a time.
+      madvise(data, file->size, MADV_SEQUENTIAL);
+      madvise(data, file->size, MADV_WILLNEED);
+      file->data = data;
+    }
+    close(fd);
+
+    numberOfTotalBytesInAllWads += file->size;
+  }
+
+  memory_reference_t *mem_ref = memory_reference_new(context);
+  write_i32_to_wasm_memory(memory_reference_data(mem_ref) + numberOfWadsOffset,
+                           wads->count);
+  write_i32_to_wasm_memory(memory_reference_data(mem_ref) +
+                               numberOfTotalBytesInAllWadsOffset,
+                           numberOfTotalBytesInAllWads);
+  memory_reference_delete(mem_ref);
+
+  *out = wads;
+}
+
+void wad_files_copy_to_memory(doom_module_context_t *context, wad_files_t *wads,
+                              int32_t wadDataDestinationOffset,
+                              int32_t byteLengthOfEachWadOffset) {
+  memory_reference_t *mem_ref = memory_reference_new(context);
+
+  uint8_t *dataDest = memory_reference_data(mem_ref) + wadDataDestinationOffset;
+  uint8_t *byteLengthDest =
+      memory_reference_data(mem_ref) + byteLengthOfEachWadOffset;
+
+  for (int i = 0; i < wads->count; i++) {
+    wad_file_t *file = &wads->files[i];
+    if (file->size > 0) {
+      memcpy(dataDest, file->data, file->size);
+    }
+    write_i32_to_wasm_memory(byteLengthDest, file->size);
+
+    dataDest += file->size;
+    byteLengthDest += 4;
+  }
+
+  memory_reference_delete(mem_ref);
+  wad_files_delete(wads);
+}
+
+void wad_files_delete(wad_files_t *wads) {
+  for (int i = 0; i < wads->count; i++) {
+    if (wads->files[i].size > 0) {
+      munmap((void *)wads->files[i].data, wads->files[i].size);
+    }
+  }
+  free(wads->files);
+  free(wads);
+}
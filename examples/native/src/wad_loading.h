@@ -0,0 +1,39 @@
+#ifndef WAD_LOADING_H_
+#define WAD_LOADING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "doom_exports.h"
+
+/*
+  Loading of WAD files from disk, shared by every implementation of the imports
+  `loading_wadSizes` and `loading_readWads`.
+
+  Each WAD file is opened, and mapped into memory, just once, by
+  `wad_files_report_sizes`, and then copied straight from that mapping into the
+  memory of the Doom WebAssembly module by `wad_files_copy_to_memory`.
+*/
+
+typedef struct wad_files wad_files_t;
+
+// Does the work of `loading_wadSizes`, for the WAD files in the config of
+// `context`, which are mapped into memory and returned via `out`.
+//
+// The caller receives ownership of `*out`, which should be passed to
+// `wad_files_copy_to_memory` when Doom calls `loading_readWads`. `*out` is
+// NULL if there are no WAD files to load, as then Doom never calls
+// `loading_readWads`.
+void wad_files_report_sizes(doom_module_context_t *context,
+                            int32_t numberOfWadsOffset,
+                            int32_t numberOfTotalBytesInAllWadsOffset,
+                            wad_files_t **out);
+
+// Does the work of `loading_readWads`, then deletes `wads`.
+void wad_files_copy_to_memory(doom_module_context_t *context, wad_files_t *wads,
+                              int32_t wadDataDestinationOffset,
+                              int32_t byteLengthOfEachWadOffset);
+
+void wad_files_delete(wad_files_t *wads);
+
+#endif
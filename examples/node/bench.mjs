@@ -0,0 +1,81 @@
+/*
+  Runs Doom under Node, headless, via the same host the browser example uses
+  (../browser/doom_host.mjs), and reports how fast it runs.
+
+  Two measurements are made:
+  1. Tics per second: Doom's clock advances by a millisecond each time Doom asks
+     for the time, so Doom never waits for a tic to be due, and runs as fast as
+     it can. Every frame is converted to RGBA, as it would be for a canvas.
+  2. Milliseconds per frame: Doom runs in real time, at 35 tics per second, on
+     the host's scheduler, and the time spent in each call of `tickGame` (which
+     includes converting the frame) is recorded.
+
+  Usage: node bench.mjs path-to-doom.wasm [tics] [seconds-of-real-time]
+*/
+
+import { readFile } from "node:fs/promises";
+import { performance } from "node:perf_hooks";
+
+import { loadDoom, TICS_PER_SECOND } from "../browser/doom_host.mjs";
+
+const DEFAULT_TICS = 2000;
+const DEFAULT_REAL_TIME_SECONDS = 5;
+
+// Each call of `timeInMilliseconds` advances time by this many milliseconds, so
+// Doom's wait for the next tic (it polls the time until 1000/35 milliseconds have
+// passed) takes the same number of calls every tic.
+const MILLISECONDS_PER_TIME_CHECK = 1;
+
+async function measureTicsPerSecond(module, tics) {
+  let time = 0;
+  const doom = await loadDoom(module, {
+    onFrame: () => {},
+    timeInMilliseconds: () => (time += MILLISECONDS_PER_TIME_CHECK),
+    onInfoMessage: () => {},
+  });
+
+  const start = performance.now();
+  for (let i = 0; i < tics; i++) {
+    doom.tick();
+  }
+  const elapsed = performance.now() - start;
+
+  console.log(`tics:          ${tics} in ${elapsed.toFixed(0)} ms, ${(tics / (elapsed / 1000)).toFixed(0)} tics per second, ${(elapsed / doom.framesDrawn).toFixed(3)} ms per frame`);
+}
+
+async function measureRealTime(module, seconds) {
+  const doom = await loadDoom(module, {
+    onFrame: () => {},
+    onInfoMessage: () => {},
+  });
+
+  // Time each call of `tickGame` made by the host's scheduler
+  const tickTimes = [];
+  const tick = doom.tick.bind(doom);
+  doom.tick = () => {
+    const start = performance.now();
+    tick();
+    tickTimes.push(performance.now() - start);
+  };
+
+  const framesBefore = doom.framesDrawn;
+  doom.start();
+  await new Promise((resolve) => setTimeout(resolve, seconds * 1000));
+  doom.stop();
+
+  const frames = doom.framesDrawn - framesBefore;
+  const total = tickTimes.reduce((a, b) => a + b, 0);
+  const max = Math.max(...tickTimes);
+  console.log(`real time:     ${frames} frames in ${seconds} s (${TICS_PER_SECOND} expected per second), ${(total / frames).toFixed(3)} ms per frame, ${max.toFixed(3)} ms longest tickGame call`);
+}
+
+const [pathToDoomWasm, tics = DEFAULT_TICS, seconds = DEFAULT_REAL_TIME_SECONDS] = process.argv.slice(2);
+if (!pathToDoomWasm) {
+  console.error("Usage: node bench.mjs path-to-doom.wasm [tics] [seconds-of-real-time]");
+  process.exit(1);
+}
+
+// Compile once, and instantiate it for each measurement
+const module = await WebAssembly.compile(await readFile(pathToDoomWasm));
+await measureTicsPerSecond(module, Number(tics));
+await measureRealTime(module, Number(seconds));
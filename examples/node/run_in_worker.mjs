@@ -0,0 +1,69 @@
+/*
+  Runs Doom under Node in a `worker_threads` Worker, headless, via the same two
+  modules the browser example uses to run Doom in a Web Worker
+  (../browser/doom_worker.mjs, and ../browser/doom_in_worker.mjs on this side).
+
+  For each way frames can be handed over (shared through a SharedArrayBuffer, and
+  posted), Doom runs in real time while this side holds down a key now and then,
+  and "paints" the latest frame every 1000/60 milliseconds, as a browser would.
+  It reports how many frames arrived, how many were painted, and how long this
+  side spent painting.
+
+  Usage: node run_in_worker.mjs path-to-doom.wasm [seconds]
+*/
+
+import { readFile } from "node:fs/promises";
+import { performance } from "node:perf_hooks";
+import { Worker } from "node:worker_threads";
+
+import { startDoomInWorker } from "../browser/doom_in_worker.mjs";
+
+const DEFAULT_SECONDS = 5;
+const PAINT_INTERVAL_MS = 1000 / 60;
+const KEY_INTERVAL_MS = 200;
+
+async function run(bytes, sharedFrames, seconds) {
+  const worker = new Worker(new URL("../browser/doom_worker.mjs", import.meta.url));
+  const doom = await startDoomInWorker(worker, bytes, { sharedFrames });
+
+  let framesArrived = 0;
+  worker.on("message", (message) => message.type === "frame" && framesArrived++);
+
+  let paintTime = 0;
+  let checksum = 0;
+  const painter = setInterval(() => {
+    const start = performance.now();
+    doom.paintLatestFrame((rgbaPixels) => {
+      // Something that depends on every frame painted, so painting is never skipped over
+      checksum = (checksum + rgbaPixels[0] + rgbaPixels[rgbaPixels.length - 4]) | 0;
+    });
+    paintTime += performance.now() - start;
+  }, PAINT_INTERVAL_MS);
+
+  // Press and release the fire key, over and over
+  const fire = doom.doomKeyFor("Control");
+  let isDown = false;
+  const presser = setInterval(() => {
+    isDown = !isDown;
+    isDown ? doom.reportKeyDown(fire) : doom.reportKeyUp(fire);
+  }, KEY_INTERVAL_MS);
+
+  await new Promise((resolve) => setTimeout(resolve, seconds * 1000));
+  clearInterval(presser);
+  clearInterval(painter);
+  await doom.stop();
+  await worker.terminate();
+
+  const arrived = sharedFrames ? "" : ` (of ${framesArrived} posted)`;
+  console.log(`${sharedFrames ? "shared" : "posted"} frames: ${doom.framesPainted} painted${arrived} in ${seconds} s, ${(paintTime / Math.max(1, doom.framesPainted)).toFixed(3)} ms per painted frame (checksum ${checksum})`);
+}
+
+const [pathToDoomWasm, seconds = DEFAULT_SECONDS] = process.argv.slice(2);
+if (!pathToDoomWasm) {
+  console.error("Usage: node run_in_worker.mjs path-to-doom.wasm [seconds]");
+  process.exit(1);
+}
+
+const bytes = await readFile(pathToDoomWasm);
+await run(bytes, true, Number(seconds));
+await run(bytes, false, Number(seconds));
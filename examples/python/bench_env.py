@@ -0,0 +1,44 @@
+"""
+Reports how many steps per second Doom runs at as a vectorized environment (see doom_env.py).
+
+Each step of each instance of Doom holds down a random key, and runs a tic.
+
+Expected to be run a main Python program.
+Accepts '--help' command line arg as a request for details on how to be run.
+"""
+
+import os, time, argparse
+
+import numpy as np
+
+from doom_env import DoomVectorEnv
+
+
+def main(path_to_doom_wasm, num_envs, num_workers, steps, tics_per_step):
+  with DoomVectorEnv(path_to_doom_wasm, num_envs, num_workers=num_workers, tics_per_step=tics_per_step) as env:
+    rng = np.random.default_rng(0)
+    env.reset()
+
+    start = time.perf_counter()
+    for _ in range(steps):
+      env.step(rng.integers(0, env.num_actions, size=num_envs))
+    elapsed = time.perf_counter() - start
+
+  total_steps = steps * num_envs
+  print(f'{num_envs} instances of Doom, on {num_workers} worker processes')
+  print(f'{total_steps} steps in {elapsed:.2f} s: {total_steps / elapsed:.0f} steps per second, {total_steps * tics_per_step / elapsed:.0f} tics per second')
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(
+    description='Measure how many steps per second DOOM runs at, as a vectorized environment')
+
+  parser.add_argument('path_to_doom_wasm', help='Path to the WebAssembly module that contains the logic of Doom')
+  parser.add_argument('--num-envs', type=int, default=os.cpu_count(), help='Number of instances of Doom to step together')
+  parser.add_argument('--num-workers', type=int, default=os.cpu_count(), help='Number of worker processes to run the instances on')
+  parser.add_argument('--steps', type=int, default=1000, help='Number of steps to run each instance for')
+  parser.add_argument('--tics-per-step', type=int, default=1, help='Number of tics each step runs')
+
+  args = parser.parse_args()
+
+  main(args.path_to_doom_wasm, args.num_envs, min(args.num_workers, args.num_envs), args.steps, args.tics_per_step)
@@ -0,0 +1,298 @@
+"""
+Runs many instances of Doom via WebAssembly, headless, as a Gym-style vectorized environment.
+
+Each instance of Doom runs in one of a pool of worker processes, and draws its
+frames straight into a block of shared memory that's viewed by the main process
+as a single NumPy array of observations, so no frame is ever pickled or sent
+over a pipe. Only actions, and acknowledgements, are.
+
+Doom draws nothing to the screen here, and time only passes when Doom asks what
+time it is, so every instance given the same actions draws the same frames.
+
+Expected to be imported, e.g.
+
+  with DoomVectorEnv('doom.wasm', num_envs=8) as env:
+    observations, infos = env.reset()
+    observations, rewards, terminations, truncations, infos = env.step(actions)
+
+See bench_env.py for a complete example.
+"""
+
+import sys, os, traceback
+import multiprocessing as mp
+from multiprocessing import shared_memory
+
+import numpy as np
+from wasmtime import Engine, Store, Module, Instance, Func, FuncType, ValType, Caller
+
+
+# The Doom key held down by each action, by index.
+# Action 0 holds down no key at all.
+ACTION_KEY_LABELS = [
+  None,
+  'KEY_UPARROW',
+  'KEY_DOWNARROW',
+  'KEY_LEFTARROW',
+  'KEY_RIGHTARROW',
+  'KEY_STRAFE_L',
+  'KEY_STRAFE_R',
+  'KEY_FIRE',
+  'KEY_USE',
+]
+
+# Each call of `runtimeControl.timeInMilliseconds` advances time by this many
+# milliseconds, so Doom's wait for the next tic (it polls the time until 1000/35
+# milliseconds have passed) takes the same number of calls every tic.
+_MILLISECONDS_PER_TIME_CHECK = 1
+
+
+class _HeadlessDoom:
+  """One instance of Doom, whose frames are copied to `frame_destination`, if set"""
+
+  def __init__(self, engine: Engine, module: Module):
+    self.width = 0
+    self.height = 0
+    self.frame_destination = None
+    self._time = 0
+    self._frame_buffer = None
+    self._frame_buffer_location = None
+
+    self._store = Store(engine)
+
+    i32 = ValType.i32()
+    i64 = ValType.i64()
+
+    # Implementation of each import, along with its type and whether it's passed a Caller,
+    # by the name of the import
+    import_impls = {
+      'loading.onGameInit': (FuncType([i32, i32], []), self._on_game_init, False),
+      # No custom WADs, so Doom loads the shareware WAD it embeds
+      'loading.wadSizes': (FuncType([i32, i32], []), lambda a, b: None, False),
+      'loading.readWads': (FuncType([i32, i32], []), lambda a, b: None, False),
+      'runtimeControl.timeInMilliseconds': (FuncType([], [i64]), self._time_in_milliseconds, False),
+      'ui.drawFrame': (FuncType([i32], []), self._draw_frame, True),
+      # Saving games isn't supported
+      'gameSaving.sizeOfSaveGame': (FuncType([i32], [i32]), lambda a: 0, False),
+      'gameSaving.readSaveGame': (FuncType([i32, i32], [i32]), lambda a, b: 0, False),
+      'gameSaving.writeSaveGame': (FuncType([i32, i32, i32], [i32]), lambda a, b, c: 0, False),
+      'console.onInfoMessage': (FuncType([i32, i32], []), lambda a, b: None, False),
+      'console.onErrorMessage': (FuncType([i32, i32], []), self._on_error_message, True),
+    }
+
+    # Imports are matched up with what the module imports purely by order
+    imports = []
+    for an_import in module.imports:
+      (func_type, impl, access_caller) = import_impls[f'{an_import.module}.{an_import.name}']
+      imports.append(Func(self._store, func_type, impl, access_caller=access_caller))
+
+    self._instance = Instance(self._store, module, imports)
+
+    exports = self._instance.exports(self._store)
+    self._tick_game = exports['tickGame']
+    self._report_key_down = exports['reportKeyDown']
+    self._report_key_up = exports['reportKeyUp']
+    self._action_keys = [None if label is None else exports[label].value(self._store) for label in ACTION_KEY_LABELS]
+    self._held_key = None
+
+    exports['initGame'](self._store)
+
+  def step(self, action: int, tics: int) -> None:
+    """Holds down the key for `action` (releasing any other), then runs `tics` tics"""
+    key = self._action_keys[action]
+    if key != self._held_key:
+      if self._held_key is not None:
+        self._report_key_up(self._store, self._held_key)
+      if key is not None:
+        self._report_key_down(self._store, key)
+      self._held_key = key
+
+    for _ in range(tics):
+      self._tick_game(self._store)
+
+  def _on_game_init(self, width: int, height: int) -> None:
+    self.width = width
+    self.height = height
+
+  def _time_in_milliseconds(self) -> int:
+    self._time += _MILLISECONDS_PER_TIME_CHECK
+    return self._time
+
+  def _draw_frame(self, caller: Caller, screen_buffer_offset: int) -> None:
+    if self.frame_destination is None:
+      return
+
+    # As in main.py, the view of the frame buffer is only rebuilt when Doom's memory grows
+    memory = caller.get("memory")
+    location = (memory.data_len(caller), screen_buffer_offset)
+    if location != self._frame_buffer_location:
+      buffer = memory.get_buffer_ptr(caller, size=self.width * self.height * 4, offset=screen_buffer_offset)
+      self._frame_buffer = np.frombuffer(buffer, dtype=np.uint8).reshape(self.height, self.width, 4)
+      self._frame_buffer_location = location
+
+    np.copyto(self.frame_destination, self._frame_buffer)
+
+  def _on_error_message(self, caller: Caller, message_offset: int, length: int) -> None:
+    message = caller.get("memory").read(caller, message_offset, message_offset + length)
+    print(message.decode('utf-8'), file=sys.stderr)
+
+
+def _run_worker(connection, serialized_module: bytes, number_of_instances: int, tics_per_step: int) -> None:
+  """Runs some of the instances of a `DoomVectorEnv`, as told to via `connection`"""
+  engine = Engine()
+  module = Module.deserialize(engine, serialized_module)
+
+  instances = [_HeadlessDoom(engine, module) for _ in range(number_of_instances)]
+  # Instances that haven't run a tic yet, which `reset` can use as they are
+  fresh = True
+  connection.send((instances[0].width, instances[0].height))
+
+  (shared_memory_name, shape, first_index) = connection.recv()
+  observations_memory = shared_memory.SharedMemory(name=shared_memory_name)
+  observations = np.ndarray(shape, dtype=np.uint8, buffer=observations_memory.buf)
+
+  def attach_to_observations():
+    for (i, instance) in enumerate(instances):
+      instance.frame_destination = observations[first_index + i]
+
+  attach_to_observations()
+
+  try:
+    while True:
+      (command, argument) = connection.recv()
+      try:
+        if command == 'step':
+          for (instance, action) in zip(instances, argument):
+            instance.step(action, tics_per_step)
+          fresh = False
+        elif command == 'reset':
+          if not fresh:
+            instances = [_HeadlessDoom(engine, module) for _ in range(number_of_instances)]
+            attach_to_observations()
+          # Run the first tic, so there's a frame to observe
+          for instance in instances:
+            instance.step(0, 1)
+          fresh = False
+        elif command == 'close':
+          break
+        connection.send(None)
+      except Exception:
+        connection.send(traceback.format_exc())
+  finally:
+    # Views of the shared memory must be gone before it can be closed
+    for instance in instances:
+      instance.frame_destination = None
+    del observations
+    observations_memory.close()
+    connection.close()
+
+
+class DoomVectorEnv:
+  """Runs `num_envs` instances of Doom, headless, in step with each other, on a pool of worker processes
+
+  Follows the shape of Gymnasium's `VectorEnv` API, without depending on Gymnasium:
+    - `reset()` starts every instance of Doom afresh, and returns `(observations, infos)`
+    - `step(actions)` returns `(observations, rewards, terminations, truncations, infos)`
+
+  Observations are a `(num_envs, height, width, 4)` array of uint8, the latest frame drawn
+  by each instance with its color components in the order Doom draws them: B, G, R, A
+  (`observations[..., 2::-1]` is a view of them as R, G, B).
+
+  The observations array lives in memory shared with the worker processes, and is
+  overwritten by each call of `reset` or `step`, so copy it to keep it.
+
+  Actions are one int per instance, an index into `ACTION_KEY_LABELS`: the Doom key to
+  hold down for the step. Doom exposes nothing to base a reward on, nor an end to an
+  episode, so rewards are always 0, and no instance ever terminates or is truncated.
+  """
+
+  def __init__(self, path_to_doom_wasm: str, num_envs: int, num_workers: int = None, tics_per_step: int = 1):
+    if num_workers is None:
+      num_workers = os.cpu_count()
+    num_workers = max(1, min(num_workers, num_envs))
+
+    self.num_envs = num_envs
+    self.num_actions = len(ACTION_KEY_LABELS)
+    self.tics_per_step = tics_per_step
+
+    # Compile the module just once, and have each worker load the compiled module
+    engine = Engine()
+    serialized_module = Module.from_file(engine, path_to_doom_wasm).serialize()
+
+    # Workers are started afresh, rather than forked from a process that's already
+    # using Wasmtime
+    context = mp.get_context('spawn')
+    self._connections = []
+    self._workers = []
+    self._first_index_of_worker = []
+    for w in range(num_workers):
+      first_index = num_envs * w // num_workers
+      number_of_instances = num_envs * (w + 1) // num_workers - first_index
+      (parent_connection, child_connection) = context.Pipe()
+      worker = context.Process(
+        target=_run_worker,
+        args=(child_connection, serialized_module, number_of_instances, tics_per_step),
+        daemon=True)
+      worker.start()
+      child_connection.close()
+      self._connections.append(parent_connection)
+      self._workers.append(worker)
+      self._first_index_of_worker.append(first_index)
+
+    (width, height) = self._connections[0].recv()
+    for connection in self._connections[1:]:
+      connection.recv()
+
+    shape = (num_envs, height, width, 4)
+    self._observations_memory = shared_memory.SharedMemory(create=True, size=int(np.prod(shape)))
+    self.observations = np.ndarray(shape, dtype=np.uint8, buffer=self._observations_memory.buf)
+    self.observations.fill(0)
+    for (connection, first_index) in zip(self._connections, self._first_index_of_worker):
+      connection.send((self._observations_memory.name, shape, first_index))
+
+    self._rewards = np.zeros(num_envs, dtype=np.float32)
+    self._terminations = np.zeros(num_envs, dtype=bool)
+    self._truncations = np.zeros(num_envs, dtype=bool)
+
+  def reset(self):
+    self._send_to_all_workers(lambda w: ('reset', None))
+    return (self.observations, {})
+
+  def step(self, actions):
+    actions = np.asarray(actions)
+    if actions.shape != (self.num_envs,):
+      raise ValueError(f'Expected {self.num_envs} actions, got an array of shape {actions.shape}')
+    if actions.min() < 0 or actions.max() >= self.num_actions:
+      raise ValueError(f'Actions must be between 0 and {self.num_actions - 1}')
+    bounds = self._first_index_of_worker + [self.num_envs]
+    self._send_to_all_workers(lambda w: ('step', actions[bounds[w]:bounds[w + 1]].tolist()))
+    return (self.observations, self._rewards, self._terminations, self._truncations, {})
+
+  def close(self) -> None:
+    if self._observations_memory is None:
+      return
+    for connection in self._connections:
+      try:
+        connection.send(('close', None))
+      except OSError:
+        pass
+    for worker in self._workers:
+      worker.join()
+    del self.observations
+    self._observations_memory.close()
+    self._observations_memory.unlink()
+    self._observations_memory = None
+
+  def __enter__(self):
+    return self
+
+  def __exit__(self, *exc_info):
+    self.close()
+
+  def _send_to_all_workers(self, message_for_worker) -> None:
+    # Every worker gets its message before any is waited on, so they all run at once
+    for (w, connection) in enumerate(self._connections):
+      connection.send(message_for_worker(w))
+    errors = [connection.recv() for connection in self._connections]
+    for error in errors:
+      if error is not None:
+        raise RuntimeError(f'A Doom worker process failed:\n{error}')
@@ -14,7 +14,6 @@ from wasmtime import Store, Module, Instance, Func, FuncType, ValType, Caller
 
 import pygame as pg
 import numpy as np
-import einops
 
 
 def _read_string_from_memory(caller: Caller, str_offset: int, length: int) -> str:
@@ -67,6 +66,31 @@ _doom_key_label_from_pg_key = {
 
 # State shared used by implementations of the functions that Doom imports
 paths_to_wad_files = []
+wad_file_sizes = []
+
+# A view of Doom's frame buffer, as one uint32 per pixel, that's only rebuilt
+# when the buffer moves, along with the details of where it was built for
+frame_buffer = None
+frame_buffer_location = None
+
+
+def _frame_buffer_view(caller: Caller, screen_buffer_offset: int) -> np.ndarray:
+  """Returns a (height, width) array of uint32 pixels that references Doom's frame buffer in place
+
+  Doom's memory, and so the frame buffer in it, only moves when the memory grows,
+  so the view is only rebuilt when the size of the memory (or the offset of the
+  frame buffer) changes.
+  """
+  global frame_buffer, frame_buffer_location
+
+  memory = caller.get("memory")
+  location = (memory.data_len(caller), screen_buffer_offset)
+  if location != frame_buffer_location:
+    (width, height) = pg.display.get_surface().get_size()
+    buffer = memory.get_buffer_ptr(caller, size=width * height * 4, offset=screen_buffer_offset)
+    frame_buffer = np.frombuffer(buffer, dtype=np.uint32).reshape(height, width)
+    frame_buffer_location = location
+  return frame_buffer
 
 
 def loading__onGameInit(width: int, height: int) -> None:
@@ -77,7 +101,7 @@ def loading__onGameInit(width: int, height: int) -> None:
       height (int): height, in pixels, of frame buffer passed to `ui__drawFrame`
   """
   pg.init()
-  pg.display.set_mode((width, height))
+  pg.display.set_mode((width, height), depth=32)
   pg.display.set_caption('DOOM')
 
 
@@ -112,9 +136,13 @@ def loading__wadSizes(caller: Caller, number_of_wads_offset: int, number_of_tota
         byte index into Doom exported memory where the value `int32_t
         numberOfTotalBytesInAllWads` should be written in little-endian order
   """
+  global wad_file_sizes
+
   try:
+    # Remembered for `loading__readWads`, which is called next
+    wad_file_sizes = [os.path.getsize(p) for p in paths_to_wad_files]
     number_of_wads = len(paths_to_wad_files)
-    number_of_total_bytes_in_all_wads = sum([os.path.getsize(p) for p in paths_to_wad_files])
+    number_of_total_bytes_in_all_wads = sum(wad_file_sizes)
   except OSError as err:
     print(f'This error was encountered while loading a WAD file: {err}', file=sys.stderr)
     print(f'Defaulting to loading the Shareware WAD instead', file=sys.stderr)
@@ -156,23 +184,25 @@ def loading__readWads(caller: Caller, wad_data_destination_offset: int, byte_len
         `numberOfWads` `int32_t` values, in little-endian fashion, each which is
         the byte length of the respective WAD file.
   """
-  # Keep track of where the details for the current WAD should be copied
-  cur_wad_data_offset = wad_data_destination_offset
-  cur_wad_byte_length_offset = byte_length_of_each_wad_offset
-
   memory = caller.get("memory")
 
-  # Write the data for each WAD, one at a time
-  for path in paths_to_wad_files:
-    with open(path, mode='rb') as wad_file:
-      data = wad_file.read()
-      wad_file_byte_length = len(data)
+  # Read each WAD straight into Doom's memory, rather than via Python bytes
+  total_size = sum(wad_file_sizes)
+  destination = memoryview(np.frombuffer(memory.get_buffer_ptr(caller, size=total_size, offset=wad_data_destination_offset), dtype=np.uint8))
+  byte_lengths = np.frombuffer(memory.get_buffer_ptr(caller, size=4 * len(wad_file_sizes), offset=byte_length_of_each_wad_offset), dtype='<i4')
 
-      memory.write(caller, data, cur_wad_data_offset)
-      memory.write(caller, struct.pack('<i', wad_file_byte_length), cur_wad_byte_length_offset)
+  cur_wad_data_offset = 0
+  for (i, (path, size)) in enumerate(zip(paths_to_wad_files, wad_file_sizes)):
+    with open(path, mode='rb', buffering=0) as wad_file:
+      bytes_read = 0
+      while bytes_read < size:
+        n = wad_file.readinto(destination[cur_wad_data_offset + bytes_read:cur_wad_data_offset + size])
+        if not n:
+          raise OSError(f'WAD file {path} shrank while being loaded')
+        bytes_read += n
 
-      cur_wad_data_offset += wad_file_byte_length
-      cur_wad_byte_length_offset += 4
+    byte_lengths[i] = size
+    cur_wad_data_offset += size
 
 
 def runtimeControl__timeInMilliseconds() -> int:
@@ -210,44 +240,29 @@ def ui__drawFrame(caller: Caller, screen_buffer_offset: int) -> None:
           from low/first byte to high/last byte when the `int32_t` pixel is seen
           as an array of 4 bytes.
   """
-  # `display`` dimensions were set to match dimensions of Doom buffer in loading__onGameInit,
-  # so we can retrieve those here to remember the dimensions of the Doom buffer.
-  (width, height) = pg.display.get_surface().get_size()
-
-  memory = caller.get("memory")
+  frame = _frame_buffer_view(caller, screen_buffer_offset)
+  surface = pg.display.get_surface()
 
   # Doom's frame buffer is a raw chunk of contiguous bytes, 4 for each pixel, ordered row-major.
   # The pixels in Doom's frame buffer have their 8-bit color components logically
-  # ordered "ARGB", but this 32-bit value is stored in little-endian order (because
-  # WebAssembly always orders multi-byte values in a little-endian way), so the order
-  # of the bytes is reversed and is actually "BGRA".
-  #
-  # We want to use PyGame's `surfarray.blit_array` function to efficiently transfer the
-  # pixels to the PyGame surface.
-  #
-  # One of the ways to call `surfarray.blit_array` is to give it a 3d numpy array, where
-  # the highest/first dimension of this array is 'column' (i.e. column-major), the next
-  # dimension is 'row' and the next dimension is filled with (R, G, B) value that describe
-  # the color at that point.
-  #
-  # So, translating the pixels from the Doom format to the logical format expected by
-  # `surfarray.blit_array` will be done via these steps:
-  #
-  # 1. Get a 1d numpy array that references the bytes of the screen buffer, in row-major order
-  screen_buffer_byte_count = width * height * 4
-  screen_buffer_bytes = np.frombuffer(memory.get_buffer_ptr(caller, size=screen_buffer_byte_count, offset=screen_buffer_offset), dtype=np.uint8)
-  #
-  # 2. Logically rearrange the 1d array of contiguous bytes into a 3d array, while going from row-major to column-major
-  #    (many thanks to `einops` (https://einops.rocks/) for making this step so easy!)
-  pixels_in_bgra = einops.rearrange(screen_buffer_bytes, "(row col pixel) -> col row pixel", row=height, col=width)
-  #
-  # 3. Drop the alpha component from every pixel, which is the last component
-  pixels_in_bgr = pixels_in_bgra[...,:-1]
+  # ordered "ARGB", and as a uint32 (which WebAssembly always stores little-endian,
+  # so the order of the bytes is actually "BGRA") that's exactly the format of a
+  # 32-bit display surface on a little-endian machine, with the alpha ignored.
   #
-  # 4. Reverse the order of components for every pixel, so the color components are ordered (R,G,B) instead of (B,G,R)
-  pixels_in_rbg = pixels_in_bgr[...,::-1]
+  # In that case the pixels are copied straight into the surface, via a view of the
+  # surface's pixels. `surfarray` views are indexed column first, hence the transpose
+  # (which is also just a view).
+  if surface.get_bytesize() == 4 and surface.get_masks()[:3] == (0xff0000, 0x00ff00, 0x0000ff) and sys.byteorder == 'little':
+    pixels = pg.surfarray.pixels2d(surface)
+    pixels[...] = frame.T
+    # The surface is locked for as long as the view exists, and can't be flipped until it's unlocked
+    del pixels
+  else:
+    # Otherwise hand `surfarray.blit_array` a column-major array of (R, G, B) values,
+    # made of views that drop the alpha and reverse the order of the other components
+    pixels_in_bgra = frame.view(np.uint8).reshape(frame.shape + (4,))
+    pg.surfarray.blit_array(surface, pixels_in_bgra[..., 2::-1].swapaxes(0, 1))
 
-  pg.surfarray.blit_array(pg.display.get_surface(), pixels_in_rbg)
   pg.display.flip()
 
 
@@ -265,15 +265,16 @@ static int SaveGameWriter_Close(struct save_game_writer *writer) {
 
   buffer_save_game_writer_t *bufferWriter = (buffer_save_game_writer_t *)writer;
 
-  size_t sizeWritten = writeSaveGame(
-      bufferWriter->saveGameSlot, bufferWriter->buffer, bufferWriter->length);
+  size_t length = bufferWriter->length;
+  size_t sizeWritten = writeSaveGame(bufferWriter->saveGameSlot,
+                                     bufferWriter->buffer, length);
 
   if (bufferWriter->buffer) {
     free(bufferWriter->buffer);
   }
   free(bufferWriter);
 
-  if (sizeWritten != bufferWriter->length) {
+  if (sizeWritten != length) {
     return EOF;
   } else {
     return 0;
@@ -4,7 +4,13 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#ifdef __wasm__
 #define IMPORT_MODULE(moduleName) __attribute__((import_module(moduleName)))
+#else
+// Built natively (see src/native/), where the 'imports' are just functions
+// linked in from elsewhere
+#define IMPORT_MODULE(moduleName)
+#endif
 #define EXPORT __attribute__((visibility("default")))
 
 /*
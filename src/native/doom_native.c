@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "doomgeneric.h"
+#include "doomstat.h"
+#include "i_system.h"
+
+#include "doom_wasm.h"
+
+/*
+ * This file turns the very same C code that's compiled to `doom.wasm` into a
+ * native, headless, Linux executable, so it can be profiled and checked with
+ * native tools (e.g. `perf`, `valgrind --tool=cachegrind`, sanitizers).
+ *
+ * It does so by implementing every function that `doom_wasm.h` says is
+ * imported via WebAssembly, and providing a `main` that drives Doom through
+ * the same exported functions a WebAssembly host calls:
+ *  - WADs are read from the files given on the command line via `-iwad` and
+ *    `-file`, otherwise Doom loads the shareware WAD it embeds
+ *  - frames are counted, and otherwise thrown away
+ *  - time only passes when Doom asks what time it is, so every run with the
+ *    same arguments runs, and draws, exactly the same
+ *
+ * Usage:
+ *
+ *    doom [-iwad <wad>] [-file <wad>...] [-timedemo <demo> | -tics <n>]
+ *         [other Doom arguments...]
+ *
+ *  -timedemo <demo>
+ *    - plays back the named demo lump (e.g. "demo1") as fast as possible, then
+ *      exits, reporting how long that took
+ *  -tics <n>
+ *    - otherwise, Doom runs for this many tics (by default 2100, one minute of
+ *      game time) and then exits with the same report
+ *
+ * All arguments are passed along to Doom too, so e.g. `-nodraw` (don't draw
+ * anything while timing a demo) works as it does in Vanilla Doom.
+ */
+
+#define DEFAULT_TICS (60 * TICRATE)
+
+// Each call of `timeInMilliseconds` advances time by this many milliseconds,
+// so Doom's wait for the next tic (it polls the time until 1000/35
+// milliseconds have passed) takes the same number of calls every tic.
+#define MILLISECONDS_PER_TIME_CHECK 1
+
+#define MAX_PWADS 64
+
+static const char *iwadPath = NULL;
+static const char *pwadPaths[MAX_PWADS];
+static int numberOfPWads = 0;
+
+static uint64_t currentTime = 0;
+
+static int framesDrawn = 0;
+static const uint32_t *latestFrame = NULL;
+static int32_t frameWidth = 0;
+static int32_t frameHeight = 0;
+
+static boolean isTimingDemo = false;
+static struct timespec startTime;
+static int startTic = 0;
+
+// *****************************************************************************
+// *                 IMPLEMENTATIONS OF THE IMPORTED FUNCTIONS                 *
+// *****************************************************************************
+
+void onGameInit(int32_t width, int32_t height) {
+  frameWidth = width;
+  frameHeight = height;
+}
+
+// The IWAD, then each PWAD, in the order Doom is to load them
+static const char *wadPath(int index) {
+  return index == 0 ? iwadPath : pwadPaths[index - 1];
+}
+
+static long sizeOfFile(FILE *file) {
+  if (fseek(file, 0, SEEK_END) != 0) {
+    return -1;
+  }
+  long size = ftell(file);
+  rewind(file);
+  return size;
+}
+
+void wadSizes(int32_t *numberOfWads, size_t *numberOfTotalBytesInAllWads) {
+  if (iwadPath == NULL) {
+    if (numberOfPWads > 0) {
+      I_Error("PWADs were given via -file, but no IWAD was given via -iwad");
+    }
+    return; // Doom loads the shareware WAD
+  }
+
+  size_t totalBytes = 0;
+  for (int i = 0; i < 1 + numberOfPWads; i++) {
+    FILE *file = fopen(wadPath(i), "rb");
+    long size = file ? sizeOfFile(file) : -1;
+    if (size < 0) {
+      I_Error("Unable to read the WAD file '%s'", wadPath(i));
+    }
+    fclose(file);
+    totalBytes += size;
+  }
+
+  *numberOfWads = 1 + numberOfPWads;
+  *numberOfTotalBytesInAllWads = totalBytes;
+}
+
+void readWads(uint8_t *wadDataDestination, int32_t *byteLengthOfEachWad) {
+  for (int i = 0; i < 1 + numberOfPWads; i++) {
+    FILE *file = fopen(wadPath(i), "rb");
+    long size = file ? sizeOfFile(file) : -1;
+    if (size < 0 || fread(wadDataDestination, 1, size, file) != (size_t)size) {
+      I_Error("Unable to read the WAD file '%s'", wadPath(i));
+    }
+    fclose(file);
+    byteLengthOfEachWad[i] = size;
+    wadDataDestination += size;
+  }
+}
+
+void drawFrame(uint32_t *screenBuffer) {
+  framesDrawn++;
+  latestFrame = screenBuffer;
+}
+
+void onInfoMessage(const char *message, size_t length) {
+  printf("%.*s\n", (int)length, message);
+}
+
+void onErrorMessage(const char *message, size_t length) {
+  fprintf(stderr, "%.*s\n", (int)length, message);
+}
+
+uint64_t timeInMilliseconds() {
+  currentTime += MILLISECONDS_PER_TIME_CHECK;
+  return currentTime;
+}
+
+// Saving games isn't supported
+
+size_t sizeOfSaveGame(int32_t gameSaveId) { return 0; }
+
+size_t readSaveGame(int32_t gameSaveId, uint8_t *dataDestination) {
+  return 0;
+}
+
+size_t writeSaveGame(int32_t gameSaveId, uint8_t *data, size_t length) {
+  return 0;
+}
+
+// *****************************************************************************
+// *                                  RUNNING                                  *
+// *****************************************************************************
+
+// A hash (FNV-1a) of the latest frame drawn, to tell whether two runs (e.g.
+// one built with sanitizers, one without) drew the same thing
+static uint32_t hashOfLatestFrame() {
+  uint32_t hash = 2166136261u;
+  if (latestFrame != NULL) {
+    const uint8_t *bytes = (const uint8_t *)latestFrame;
+    for (size_t i = 0; i < (size_t)frameWidth * frameHeight * 4; i++) {
+      hash = (hash ^ bytes[i]) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+static void report() {
+  struct timespec endTime;
+  clock_gettime(CLOCK_MONOTONIC, &endTime);
+  double seconds = (endTime.tv_sec - startTime.tv_sec) +
+                   (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+
+  int tics = gametic - startTic;
+  printf("Ran %i tics in %.3f seconds: %.1f tics per second, %i frames drawn "
+         "(the last with hash %08x)\n",
+         tics, seconds, tics / seconds, framesDrawn, hashOfLatestFrame());
+  fflush(stdout);
+}
+
+// Doom ends a timed demo via I_Error, and I_Error and I_Quit don't exit in the
+// WebAssembly build (see i_system.c), they just run every function registered
+// via I_AtExit. So these are how this executable exits.
+
+static void exitOnQuit() {
+  report();
+  exit(EXIT_SUCCESS);
+}
+
+static void exitOnError() {
+  // A timed demo that finished has already stopped timing
+  boolean finishedTimingDemo = isTimingDemo && !timingdemo;
+  if (finishedTimingDemo) {
+    report();
+  }
+  exit(finishedTimingDemo ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  int tics = DEFAULT_TICS;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-iwad") == 0 && i + 1 < argc) {
+      iwadPath = argv[++i];
+    } else if (strcmp(argv[i], "-file") == 0) {
+      while (i + 1 < argc && argv[i + 1][0] != '-' &&
+             numberOfPWads < MAX_PWADS) {
+        pwadPaths[numberOfPWads++] = argv[++i];
+      }
+    } else if (strcmp(argv[i], "-tics") == 0 && i + 1 < argc) {
+      tics = atoi(argv[++i]);
+    }
+  }
+
+  // So an error while Doom starts up exits too
+  I_AtExit(exitOnError, true);
+
+  doomgeneric_Create(argc, argv);
+  // Doom starts timing a demo given via `-timedemo`, if it can
+  isTimingDemo = timingdemo;
+
+  // Functions registered via I_AtExit run in the reverse of the order they're
+  // registered (and only those registered with `true` run on an error), so
+  // these run before any Doom registered while starting up. Which matters for
+  // G_CheckDemoStatus: on an error while timing a demo it stops timing, and
+  // reports the timing via another I_Error, which would pass for the end of
+  // the demo.
+  I_AtExit(exitOnError, true);
+  I_AtExit(exitOnQuit, false);
+
+  // Doom runs its first tic while starting up, which isn't timed
+  clock_gettime(CLOCK_MONOTONIC, &startTime);
+  startTic = gametic;
+  if (isTimingDemo) {
+    // Timing the demo ends with Doom calling I_Error
+    while (true) {
+      tickGame();
+    }
+  } else {
+    while (gametic - startTic < tics) {
+      tickGame();
+    }
+  }
+
+  report();
+  return EXIT_SUCCESS;
+}